@@ -777,6 +777,60 @@ cbs_h266_replace_ps(6, VPS, vps, vps_video_parameter_set_id)
 cbs_h266_replace_ps(6, SPS, sps, sps_seq_parameter_set_id)
 cbs_h266_replace_ps(6, PPS, pps, pps_pic_parameter_set_id)
 
+static int cbs_h266_save_ps_data(uint8_t **data, size_t *data_size,
+                                 const CodedBitstreamUnit *unit)
+{
+    av_freep(data);
+    *data_size = 0;
+
+    *data = av_memdup(unit->data, unit->data_size);
+    if (!*data)
+        return AVERROR(ENOMEM);
+    *data_size = unit->data_size;
+
+    return 0;
+}
+
+/**
+ * With reuse_ps, reference the stored content if the unit repeats the
+ * stored SPS or PPS with the same id, 1 is returned then.
+ */
+static int cbs_h266_reuse_ps(CodedBitstreamContext *ctx,
+                             CodedBitstreamUnit *unit)
+{
+    CodedBitstreamH266Context *h266 = ctx->priv_data;
+    void *content = NULL;
+
+    // the id follows the two byte NAL unit header
+    if (unit->data_size < 3)
+        return 0;
+
+    if (unit->type == VVC_SPS_NUT) {
+        const int id = unit->data[2] >> 4;
+
+        if (h266->sps[id] && h266->sps_data_size[id] == unit->data_size &&
+            !memcmp(h266->sps_data[id], unit->data, unit->data_size))
+            content = h266->sps[id];
+    } else {
+        const int id = unit->data[2] >> 2;
+        const H266RawPPS *pps = h266->pps[id];
+
+        // the PPS is parsed against its SPS, which may have changed
+        if (pps && h266->pps_data_size[id] == unit->data_size &&
+            h266->pps_sps[id] == h266->sps[pps->pps_seq_parameter_set_id] &&
+            !memcmp(h266->pps_data[id], unit->data, unit->data_size))
+            content = h266->pps[id];
+    }
+
+    if (!content)
+        return 0;
+
+    unit->content_ref = ff_refstruct_ref(content);
+    unit->content     = unit->content_ref;
+
+    return 1;
+}
+
 static int cbs_h266_replace_ph(CodedBitstreamContext *ctx,
                                CodedBitstreamUnit *unit,
                                H266RawPictureHeader *ph)
@@ -1036,6 +1090,7 @@ static int cbs_h265_read_nal_unit(CodedBitstreamContext *ctx,
 static int cbs_h266_read_nal_unit(CodedBitstreamContext *ctx,
                                   CodedBitstreamUnit *unit)
 {
+    CodedBitstreamH266Context *h266 = ctx->priv_data;
     GetBitContext gbc;
     int err;
 
@@ -1043,6 +1098,11 @@ static int cbs_h266_read_nal_unit(CodedBitstreamContext *ctx,
     if (err < 0)
         return err;
 
+    if (h266->reuse_ps &&
+        (unit->type == VVC_SPS_NUT || unit->type == VVC_PPS_NUT) &&
+        cbs_h266_reuse_ps(ctx, unit))
+        return 0;
+
     err = ff_cbs_alloc_unit_content(ctx, unit);
     if (err < 0)
         return err;
@@ -1088,6 +1148,13 @@ static int cbs_h266_read_nal_unit(CodedBitstreamContext *ctx,
             err = cbs_h266_replace_sps(ctx, unit);
             if (err < 0)
                 return err;
+
+            if (h266->reuse_ps) {
+                err = cbs_h266_save_ps_data(&h266->sps_data[sps->sps_seq_parameter_set_id],
+                                            &h266->sps_data_size[sps->sps_seq_parameter_set_id], unit);
+                if (err < 0)
+                    return err;
+            }
         }
         break;
 
@@ -1102,6 +1169,15 @@ static int cbs_h266_read_nal_unit(CodedBitstreamContext *ctx,
             err = cbs_h266_replace_pps(ctx, unit);
             if (err < 0)
                 return err;
+
+            if (h266->reuse_ps) {
+                const int id = pps->pps_pic_parameter_set_id;
+
+                err = cbs_h266_save_ps_data(&h266->pps_data[id], &h266->pps_data_size[id], unit);
+                if (err < 0)
+                    return err;
+                ff_refstruct_replace(&h266->pps_sps[id], h266->sps[pps->pps_seq_parameter_set_id]);
+            }
         }
         break;
 
@@ -1918,6 +1994,16 @@ static void cbs_h266_flush(CodedBitstreamContext *ctx)
     for (int i = 0; i < FF_ARRAY_ELEMS(h266->pps); i++)
         ff_refstruct_unref(&h266->pps[i]);
     ff_refstruct_unref(&h266->ph_ref);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(h266->sps_data); i++) {
+        av_freep(&h266->sps_data[i]);
+        h266->sps_data_size[i] = 0;
+    }
+    for (int i = 0; i < FF_ARRAY_ELEMS(h266->pps_data); i++) {
+        av_freep(&h266->pps_data[i]);
+        h266->pps_data_size[i] = 0;
+        ff_refstruct_unref(&h266->pps_sps[i]);
+    }
 }
 
 static void cbs_h266_close(CodedBitstreamContext *ctx)
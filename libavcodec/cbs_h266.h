@@ -874,6 +874,20 @@ typedef struct CodedBitstreamH266Context {
     H266RawPPS  *pps[VVC_MAX_PPS_COUNT]; ///< RefStruct references
     H266RawPictureHeader *ph;
     void *ph_ref; ///< RefStruct reference backing ph above
+
+    /**
+     * If set, an SPS or PPS which repeats the stored one with the same id
+     * byte for byte is not parsed again, the unit references the stored
+     * content instead. Only for users which never modify the content.
+     */
+    int reuse_ps;
+
+    // Payloads of the stored parameter sets, only with reuse_ps.
+    uint8_t *sps_data[VVC_MAX_SPS_COUNT];
+    size_t   sps_data_size[VVC_MAX_SPS_COUNT];
+    uint8_t *pps_data[VVC_MAX_PPS_COUNT];
+    size_t   pps_data_size[VVC_MAX_PPS_COUNT];
+    H266RawSPS *pps_sps[VVC_MAX_PPS_COUNT]; ///< RefStruct references, the SPS each PPS was parsed with
 } CodedBitstreamH266Context;
 
 #endif /* AVCODEC_CBS_H266_H */
@@ -1154,7 +1154,7 @@ static int FUNC(sps)(CodedBitstreamContext *ctx, RWContext *rw,
                 flags(sps_loop_filter_across_subpic_enabled_flag[0], 1, 0);
             } else {
                 infer(sps_subpic_treated_as_pic_flag[0], 1);
-                infer(sps_loop_filter_across_subpic_enabled_flag[0], 1);
+                infer(sps_loop_filter_across_subpic_enabled_flag[0], 0);
             }
             for (i = 1; i <= current->sps_num_subpics_minus1; i++) {
                 if (!current->sps_subpic_same_size_flag) {
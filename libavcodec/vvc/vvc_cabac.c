@@ -1757,27 +1757,58 @@ static int get_local_sum_ts(const int *level, const int w, const int h, const in
     return loc_sum;
 }
 
-static int get_gtx_flag_inc(const ResidualCoding* rc, const int xc, const int yc, const int last)
+// ctxInc contributions of the diagonal d = xC + yC, indexed by [chroma][d]
+static const uint8_t sig_coeff_flag_d_inc[2][64] = {
+    {
+        8, 8, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    {
+        4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+};
+
+static const uint8_t gtx_flag_d_inc[2][64] = {
+    {
+       16, 11, 11,  6,  6,  6,  6,  6,  6,  6,  1,  1,  1,  1,  1,  1,
+        1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
+        1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
+        1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
+    },
+    {
+       27, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+       22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+       22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+       22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+    },
+};
+
+// sig_coeff_flag ctxInc base, indexed by [chroma][QState]
+static const uint8_t sig_coeff_flag_qstate_inc[2][4] = {
+    {  0,  0, 12, 24 },
+    { 36, 36, 44, 52 },
+};
+
+static av_always_inline int get_gtx_flag_inc(const ResidualCoding* rc, const int xc, const int yc,
+    const int last, const int chroma)
 {
     const TransformBlock *tb = rc->tb;
-    int inc;
-    if (last) {
-        const int incs[] = {0, 21, 21};
-        inc =  incs[tb->c_idx];
-    } else {
-        const int d = xc + yc;
-        const int local_sum_sig = get_local_sum(rc->sig_coeff_flag,
-                tb->tb_width,tb->tb_height, xc, yc, rc->hist_value);
-        const int loc_sum_abs_pass1 = get_local_sum(rc->abs_level_pass1,
-                tb->tb_width, tb->tb_height, xc, yc, rc->hist_value);
-        const int offset = FFMIN(loc_sum_abs_pass1 - local_sum_sig, 4);
-
-        if (!tb->c_idx)
-            inc =  1 + offset + (!d ? 15 : (d < 3 ? 10 : (d < 10 ? 5 : 0)));
-        else
-            inc = 22 + offset + (!d ? 5 : 0);
-    }
-    return inc;
+    int local_sum_sig, loc_sum_abs_pass1;
+
+    if (last)
+        return chroma ? 21 : 0;
+
+    local_sum_sig     = get_local_sum(rc->sig_coeff_flag,
+            tb->tb_width,tb->tb_height, xc, yc, rc->hist_value);
+    loc_sum_abs_pass1 = get_local_sum(rc->abs_level_pass1,
+            tb->tb_width, tb->tb_height, xc, yc, rc->hist_value);
+
+    return FFMIN(loc_sum_abs_pass1 - local_sum_sig, 4) + gtx_flag_d_inc[chroma][xc + yc];
 }
 
 static int abs_level_gtx_flag_decode(VVCLocalContext *lc, const int inc)
@@ -1796,56 +1827,55 @@ static int par_level_flag_ts_decode(VVCLocalContext *lc)
     return GET_CABAC(PAR_LEVEL_FLAG + inc);
 }
 
-static int sb_coded_flag_decode(VVCLocalContext *lc, const uint8_t *sb_coded_flag,
-    const ResidualCoding *rc, const int xs, const int ys)
+static av_always_inline int sb_coded_flag_decode(VVCLocalContext *lc, const uint8_t *sb_coded_flag,
+    const ResidualCoding *rc, const int xs, const int ys, const int chroma)
 {
-    const H266RawSliceHeader *rsh = lc->sc->sh.r;
-    const TransformBlock *tb      = rc->tb;
-    const int w                   = rc->width_in_sbs;
-    const int h                   = rc->height_in_sbs;
-    int inc;
+    const int w      = rc->width_in_sbs;
+    const int h      = rc->height_in_sbs;
+    const int right  = (xs < w - 1) ? sb_coded_flag[1] : 0;
+    const int bottom = (ys < h - 1) ? sb_coded_flag[w] : 0;
+    const int inc    = (right | bottom) + (chroma ? 2 : 0);
 
-    if (tb->ts && !rsh->sh_ts_residual_coding_disabled_flag) {
-        const int left  = xs > 0 ? sb_coded_flag[-1] : 0;
-        const int above = ys > 0 ? sb_coded_flag[-w] : 0;
-        inc = left + above + 4;
-    } else {
-        const int right  = (xs < w - 1) ? sb_coded_flag[1] : 0;
-        const int bottom = (ys < h - 1) ? sb_coded_flag[w] : 0;
-        inc = (right | bottom) + (tb->c_idx ? 2 : 0);
-    }
     return GET_CABAC(SB_CODED_FLAG + inc);
 }
 
-static int sig_coeff_flag_decode(VVCLocalContext *lc, const ResidualCoding* rc, const int xc, const int yc)
+static int sb_coded_flag_ts_decode(VVCLocalContext *lc, const uint8_t *sb_coded_flag,
+    const ResidualCoding *rc, const int xs, const int ys)
 {
-    const H266RawSliceHeader *rsh = lc->sc->sh.r;
-    const TransformBlock *tb      = rc->tb;
-    int inc;
+    const int w     = rc->width_in_sbs;
+    const int left  = xs > 0 ? sb_coded_flag[-1] : 0;
+    const int above = ys > 0 ? sb_coded_flag[-w] : 0;
+    const int inc   = left + above + 4;
 
-    if (tb->ts && !rsh->sh_ts_residual_coding_disabled_flag) {
-        const int local_num_sig = get_local_sum_ts(rc->sig_coeff_flag, tb->tb_width, tb->tb_height, xc, yc);
-        inc = 60 + local_num_sig;
-    } else {
-        const int d = xc + yc;
-        const int loc_sum_abs_pass1 = get_local_sum(rc->abs_level_pass1,
-                tb->tb_width, tb->tb_height, xc, yc, 0);
+    return GET_CABAC(SB_CODED_FLAG + inc);
+}
+
+static av_always_inline int sig_coeff_flag_decode(VVCLocalContext *lc, const ResidualCoding* rc,
+    const int xc, const int yc, const int dep_quant, const int chroma)
+{
+    const TransformBlock *tb    = rc->tb;
+    const int loc_sum_abs_pass1 = get_local_sum(rc->abs_level_pass1,
+            tb->tb_width, tb->tb_height, xc, yc, 0);
+    const int inc = sig_coeff_flag_qstate_inc[chroma][dep_quant ? rc->qstate : 0] +
+        FFMIN((loc_sum_abs_pass1 + 1) >> 1, 3) + sig_coeff_flag_d_inc[chroma][xc + yc];
 
-        if (!tb->c_idx) {
-            inc = 12 * FFMAX(0, rc->qstate - 1) + FFMIN((loc_sum_abs_pass1 + 1) >> 1, 3) + ((d < 2) ? 8 : (d < 5 ? 4 : 0));
-        } else {
-            inc = 36 + 8 * FFMAX(0, rc->qstate - 1) + FFMIN((loc_sum_abs_pass1 + 1) >> 1, 3) + (d < 2 ? 4 : 0);
-        }
-    }
     return GET_CABAC(SIG_COEFF_FLAG + inc);
 }
 
+static int sig_coeff_flag_ts_decode(VVCLocalContext *lc, const ResidualCoding* rc, const int xc, const int yc)
+{
+    const TransformBlock *tb = rc->tb;
+    const int local_num_sig  = get_local_sum_ts(rc->sig_coeff_flag, tb->tb_width, tb->tb_height, xc, yc);
+
+    return GET_CABAC(SIG_COEFF_FLAG + 60 + local_num_sig);
+}
+
 static int abs_get_rice_param(VVCLocalContext *lc, const ResidualCoding* rc,
                               const int xc, const int yc, const int base_level)
 {
     const VVCSPS *sps = lc->fc->ps.sps;
     const TransformBlock* tb = rc->tb;
-    const int rice_params[] = {
+    static const uint8_t rice_params[] = {
         0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 2, 2,
         2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3,
     };
@@ -1892,7 +1922,7 @@ static int abs_remainder_decode(VVCLocalContext *lc, const ResidualCoding* rc, c
 {
     const VVCSPS *sps             = lc->fc->ps.sps;
     const H266RawSliceHeader *rsh = lc->sc->sh.r;
-    const int base_level[][2][2]  = {
+    static const uint8_t base_level[][2][2] = {
         { {4, 4}, {4, 4} },
         { {3, 2}, {2, 1} }
     };
@@ -1918,14 +1948,14 @@ static int coeff_sign_flag_decode(VVCLocalContext *lc)
 }
 
 //9.3.4.2.10 Derivation process of ctxInc for the syntax element coeff_sign_flag for transform skip mode
-static int coeff_sign_flag_ts_decode(VVCLocalContext *lc, const CodingUnit *cu, const ResidualCoding *rc, const int xc, const int yc)
+static av_always_inline int coeff_sign_flag_ts_decode(VVCLocalContext *lc, const ResidualCoding *rc,
+    const int xc, const int yc, const int bdpcm_flag)
 {
     const TransformBlock *tb = rc->tb;
     const int w              = tb->tb_width;
     const int *level         = rc->coeff_sign_level + yc * w + xc;
     const int left_sign      = xc ? level[-1] : 0;
     const int above_sign     = yc ? level[-w] : 0;
-    const int bdpcm_flag     = cu->bdpcm_flag[tb->c_idx];
     int inc;
 
     if (left_sign == -above_sign)
@@ -1937,13 +1967,14 @@ static int coeff_sign_flag_ts_decode(VVCLocalContext *lc, const CodingUnit *cu,
     return GET_CABAC(COEFF_SIGN_FLAG + inc);
 }
 
-static int abs_level_gt1_flag_ts_decode(VVCLocalContext *lc, const CodingUnit *cu, const ResidualCoding *rc, const int xc, const int yc)
+static av_always_inline int abs_level_gt1_flag_ts_decode(VVCLocalContext *lc, const ResidualCoding *rc,
+    const int xc, const int yc, const int bdpcm_flag)
 {
     const TransformBlock *tb = rc->tb;
     const int *sig_coeff_flag = rc->sig_coeff_flag + yc * tb->tb_width + xc;
     int inc;
 
-    if (cu->bdpcm_flag[tb->c_idx]) {
+    if (bdpcm_flag) {
         inc = 67;
     } else {
         const int l = xc > 0 ? sig_coeff_flag[-1] : 0;
@@ -1963,12 +1994,12 @@ static const uint8_t qstate_translate_table[][2] = {
     { 0, 2 }, { 2, 0 }, { 1, 3 }, { 3, 1 }
 };
 
-static int dec_abs_level_decode(VVCLocalContext *lc, const ResidualCoding *rc,
-    const int xc, const int yc, int *abs_level)
+static av_always_inline int dec_abs_level_decode(VVCLocalContext *lc, const ResidualCoding *rc,
+    const int xc, const int yc, int *abs_level, const int dep_quant)
 {
     const int c_rice_param  = abs_get_rice_param(lc, rc, xc, yc, 0);
     const int dec_abs_level =  abs_decode(lc, c_rice_param);
-    const int zero_pos      = (rc->qstate < 2 ? 1 : 2) << c_rice_param;
+    const int zero_pos      = (dep_quant && rc->qstate >= 2 ? 2 : 1) << c_rice_param;
 
     *abs_level = 0;
     if (dec_abs_level != zero_pos) {
@@ -2033,11 +2064,18 @@ static void init_residual_coding(const VVCLocalContext *lc, ResidualCoding *rc,
     rc->tb = tb;
 }
 
-static int residual_ts_coding_subblock(VVCLocalContext *lc, ResidualCoding* rc, const int i)
+static av_always_inline void set_coeff(TransformBlock *tb, const int off, const int level)
+{
+    if (tb->coeffs32)
+        tb->coeffs32[off] = level;
+    else
+        tb->coeffs[off] = level;
+}
+
+static av_always_inline int residual_ts_coding_subblock(VVCLocalContext *lc, ResidualCoding* rc,
+    const int i, const int bdpcm_flag)
 {
-    const CodingUnit *cu   = lc->cu;
     TransformBlock *tb     = rc->tb;
-    const int bdpcm_flag   = cu->bdpcm_flag[tb->c_idx];
     const int xs           = rc->sb_scan_x_off[i];
     const int ys           = rc->sb_scan_y_off[i];
     uint8_t *sb_coded_flag = rc->sb_coded_flag + ys * rc->width_in_sbs + xs;
@@ -2047,7 +2085,7 @@ static int residual_ts_coding_subblock(VVCLocalContext *lc, ResidualCoding* rc,
     int abs_level_pass2[MAX_SUB_BLOCK_SIZE * MAX_SUB_BLOCK_SIZE];       ///< AbsLevelPass2
 
     if (i != rc->last_sub_block || !rc->infer_sb_cbf)
-        *sb_coded_flag = sb_coded_flag_decode(lc, sb_coded_flag, rc, xs, ys);
+        *sb_coded_flag = sb_coded_flag_ts_decode(lc, sb_coded_flag, rc, xs, ys);
     else
         *sb_coded_flag = 1;
     if (*sb_coded_flag && i < rc->last_sub_block)
@@ -2066,7 +2104,7 @@ static int residual_ts_coding_subblock(VVCLocalContext *lc, ResidualCoding* rc,
         abs_level_gtx_flag[n] = 0;
         last_scan_pos_pass1 = n;
         if (*sb_coded_flag && (n != rc->num_sb_coeff - 1 || !infer_sb_sig_coeff_flag)) {
-            *sig_coeff_flag = sig_coeff_flag_decode(lc, rc, xc, yc);
+            *sig_coeff_flag = sig_coeff_flag_ts_decode(lc, rc, xc, yc);
             rc->rem_bins_pass1--;
             if (*sig_coeff_flag)
                 infer_sb_sig_coeff_flag = 0;
@@ -2075,8 +2113,8 @@ static int residual_ts_coding_subblock(VVCLocalContext *lc, ResidualCoding* rc,
         }
         *coeff_sign_level = 0;
         if (*sig_coeff_flag) {
-            *coeff_sign_level = 1 - 2 * coeff_sign_flag_ts_decode(lc, cu, rc, xc, yc);
-            abs_level_gtx_flag[n] = abs_level_gt1_flag_ts_decode(lc, cu, rc, xc, yc);
+            *coeff_sign_level = 1 - 2 * coeff_sign_flag_ts_decode(lc, rc, xc, yc, bdpcm_flag);
+            abs_level_gtx_flag[n] = abs_level_gt1_flag_ts_decode(lc, rc, xc, yc, bdpcm_flag);
             rc->rem_bins_pass1 -= 2;
             if (abs_level_gtx_flag[n]) {
                 par_level_flag = par_level_flag_ts_decode(lc);
@@ -2138,37 +2176,61 @@ static int residual_ts_coding_subblock(VVCLocalContext *lc, ResidualCoding* rc,
                 (*abs_level)--;
         }
         if (*abs_level) {
-            tb->coeffs[off] = *coeff_sign_level * *abs_level;
+            set_coeff(tb, off, *coeff_sign_level * *abs_level);
             tb->max_scan_x = FFMAX(xc, tb->max_scan_x);
             tb->max_scan_y = FFMAX(yc, tb->max_scan_y);
             tb->min_scan_x = FFMIN(xc, tb->min_scan_x);
             tb->min_scan_y = FFMIN(yc, tb->min_scan_y);
         } else {
-            tb->coeffs[off] = 0;
+            set_coeff(tb, off, 0);
         }
     }
 
     return 0;
 }
 
-static int hls_residual_ts_coding(VVCLocalContext *lc, TransformBlock *tb)
+static av_always_inline int residual_ts_coding_subblocks(VVCLocalContext *lc, ResidualCoding *rc,
+    const int bdpcm_flag)
 {
-    ResidualCoding rc;
-    tb->min_scan_x = tb->min_scan_y = INT_MAX;
-    init_residual_coding(lc, &rc, tb->log2_tb_width, tb->log2_tb_height, tb);
-    for (int i = 0; i <= rc.last_sub_block; i++) {
-        int ret = residual_ts_coding_subblock(lc, &rc, i);
+    for (int i = 0; i <= rc->last_sub_block; i++) {
+        int ret = residual_ts_coding_subblock(lc, rc, i, bdpcm_flag);
         if (ret < 0)
             return ret;
     }
-
     return 0;
 }
 
-static inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *rc, const int i)
+static int residual_ts_coding_subblocks_bdpcm(VVCLocalContext *lc, ResidualCoding *rc)
+{
+    return residual_ts_coding_subblocks(lc, rc, 1);
+}
+
+static int residual_ts_coding_subblocks_no_bdpcm(VVCLocalContext *lc, ResidualCoding *rc)
+{
+    return residual_ts_coding_subblocks(lc, rc, 0);
+}
+
+static int hls_residual_ts_coding(VVCLocalContext *lc, TransformBlock *tb)
+{
+    ResidualCoding rc;
+    tb->min_scan_x = tb->min_scan_y = INT_MAX;
+    init_residual_coding(lc, &rc, tb->log2_tb_width, tb->log2_tb_height, tb);
+    if (lc->cu->bdpcm_flag[tb->c_idx])
+        return residual_ts_coding_subblocks_bdpcm(lc, &rc);
+    return residual_ts_coding_subblocks_no_bdpcm(lc, &rc);
+}
+
+/*
+ * The sub-block decoder is instantiated per dependent quantization mode, per
+ * luma/chroma and for the common 4x4 sub-block shape, so the context
+ * derivation and the scan position arithmetic fold to constants.
+ */
+static av_always_inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *rc, const int i,
+    const int dep_quant, const int chroma, const int log2_sb_w, const int log2_sb_h)
 {
     const H266RawSliceHeader *rsh = lc->sc->sh.r;
     TransformBlock *tb            = rc->tb;
+    const int num_sb_coeff        = 1 << (log2_sb_w + log2_sb_h);
     int first_sig_scan_pos_sb, last_sig_scan_pos_sb;
     int first_pos_mode0, first_pos_mode1;
     int infer_sb_dc_sig_coeff_flag = 0;
@@ -2179,33 +2241,31 @@ static inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *
     const int ys = rc->sb_scan_y_off[i];
     uint8_t *sb_coded_flag = rc->sb_coded_flag + ys * rc->width_in_sbs + xs;
 
-
-    av_assert0(rc->num_sb_coeff <= MAX_SUB_BLOCK_SIZE * MAX_SUB_BLOCK_SIZE);
     if (i < rc->last_sub_block && i > 0) {
-        *sb_coded_flag = sb_coded_flag_decode(lc, sb_coded_flag, rc, xs, ys);
+        *sb_coded_flag = sb_coded_flag_decode(lc, sb_coded_flag, rc, xs, ys, chroma);
         infer_sb_dc_sig_coeff_flag = 1;
     } else {
         *sb_coded_flag = 1;
     }
-    if (*sb_coded_flag && (xs > 3 || ys > 3) && !tb->c_idx)
+    if (*sb_coded_flag && (xs > 3 || ys > 3) && !chroma)
         lc->parse.mts_zero_out_sig_coeff_flag = 0;
 
     if (!*sb_coded_flag)
         return 0;
 
-    first_sig_scan_pos_sb = rc->num_sb_coeff;
+    first_sig_scan_pos_sb = num_sb_coeff;
     last_sig_scan_pos_sb = -1;
-    first_pos_mode0 = (i == rc->last_sub_block ? rc->last_scan_pos : rc->num_sb_coeff -1);
+    first_pos_mode0 = (i == rc->last_sub_block ? rc->last_scan_pos : num_sb_coeff -1);
     first_pos_mode1 = first_pos_mode0;
     for (n = first_pos_mode0; n >= 0 && rc->rem_bins_pass1 >= 4; n--) {
-        const int xc   = (xs << rc->log2_sb_w) + rc->scan_x_off[n];
-        const int yc   = (ys << rc->log2_sb_h) + rc->scan_y_off[n];
+        const int xc   = (xs << log2_sb_w) + rc->scan_x_off[n];
+        const int yc   = (ys << log2_sb_h) + rc->scan_y_off[n];
         const int last = (xc == rc->last_significant_coeff_x && yc == rc->last_significant_coeff_y);
         int *abs_level_pass1 = rc->abs_level_pass1 + yc * tb->tb_width + xc;
         int *sig_coeff_flag  = rc->sig_coeff_flag + yc * tb->tb_width + xc;
 
         if ((n > 0 || !infer_sb_dc_sig_coeff_flag ) && !last) {
-            *sig_coeff_flag = sig_coeff_flag_decode(lc, rc, xc, yc);
+            *sig_coeff_flag = sig_coeff_flag_decode(lc, rc, xc, yc, dep_quant, chroma);
             rc->rem_bins_pass1--;
             if (*sig_coeff_flag)
                 infer_sb_dc_sig_coeff_flag = 0;
@@ -2216,7 +2276,7 @@ static inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *
         *abs_level_pass1 = 0;
         if (*sig_coeff_flag) {
             int abs_level_gt1_flag, par_level_flag = 0;
-            const int inc = get_gtx_flag_inc(rc, xc, yc, last);
+            const int inc = get_gtx_flag_inc(rc, xc, yc, last, chroma);
             abs_level_gt1_flag = abs_level_gtx_flag_decode(lc, inc);
             rc->rem_bins_pass1--;
             if (abs_level_gt1_flag) {
@@ -2236,14 +2296,14 @@ static inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *
             abs_level_gt2_flag[n] = 0;
         }
 
-        if (rsh->sh_dep_quant_used_flag)
+        if (dep_quant)
             rc->qstate = qstate_translate_table[rc->qstate][*abs_level_pass1 & 1];
 
         first_pos_mode1 = n - 1;
     }
     for (n = first_pos_mode0; n > first_pos_mode1; n--) {
-        const int xc = (xs << rc->log2_sb_w) + rc->scan_x_off[n];
-        const int yc = (ys << rc->log2_sb_h) + rc->scan_y_off[n];
+        const int xc = (xs << log2_sb_w) + rc->scan_x_off[n];
+        const int yc = (ys << log2_sb_h) + rc->scan_y_off[n];
         const int *abs_level_pass1 = rc->abs_level_pass1 + yc * tb->tb_width + xc;
         int *abs_level             = rc->abs_level + yc * tb->tb_width + xc;
 
@@ -2255,12 +2315,12 @@ static inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *
         }
     }
     for (n = first_pos_mode1; n >= 0; n--) {
-        const int xc   = (xs << rc->log2_sb_w) + rc->scan_x_off[n];
-        const int yc   = (ys << rc->log2_sb_h) + rc->scan_y_off[n];
+        const int xc   = (xs << log2_sb_w) + rc->scan_x_off[n];
+        const int yc   = (ys << log2_sb_h) + rc->scan_y_off[n];
         int *abs_level = rc->abs_level + yc * tb->tb_width + xc;
 
         if (*sb_coded_flag) {
-            const int dec_abs_level = dec_abs_level_decode(lc, rc, xc, yc, abs_level);
+            const int dec_abs_level = dec_abs_level_decode(lc, rc, xc, yc, abs_level, dep_quant);
             ep_update_hist(lc->ep, rc, dec_abs_level, 0);
         }
         if (*abs_level > 0) {
@@ -2268,19 +2328,20 @@ static inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *
                 last_sig_scan_pos_sb = n;
             first_sig_scan_pos_sb = n;
         }
-        if (rsh->sh_dep_quant_used_flag)
+        if (dep_quant)
             rc->qstate = qstate_translate_table[rc->qstate][*abs_level & 1];
     }
-    sig_hidden_flag = rsh->sh_sign_data_hiding_used_flag &&
+    // sh_sign_data_hiding_used_flag is inferred to be 0 when dependent quantization is used
+    sig_hidden_flag = !dep_quant && rsh->sh_sign_data_hiding_used_flag &&
         (last_sig_scan_pos_sb - first_sig_scan_pos_sb > 3 ? 1 : 0);
 
-    if (rsh->sh_dep_quant_used_flag)
+    if (dep_quant)
         rc->qstate = start_qstate_sb;
-    n = (i == rc->last_sub_block ? rc->last_scan_pos : rc->num_sb_coeff -1);
+    n = (i == rc->last_sub_block ? rc->last_scan_pos : num_sb_coeff -1);
     for (/* nothing */; n >= 0; n--) {
         int trans_coeff_level;
-        const int xc  = (xs << rc->log2_sb_w) + rc->scan_x_off[n];
-        const int yc  = (ys << rc->log2_sb_h) + rc->scan_y_off[n];
+        const int xc  = (xs << log2_sb_w) + rc->scan_x_off[n];
+        const int yc  = (ys << log2_sb_h) + rc->scan_y_off[n];
         const int off = yc * tb->tb_width + xc;
         const int *abs_level = rc->abs_level + off;
 
@@ -2288,7 +2349,7 @@ static inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *
             int sign = 1;
             if (!sig_hidden_flag || (n != first_sig_scan_pos_sb))
                 sign = 1 - 2 * coeff_sign_flag_decode(lc);
-            if (rsh->sh_dep_quant_used_flag) {
+            if (dep_quant) {
                 trans_coeff_level = (2 * *abs_level - (rc->qstate > 1)) * sign;
             } else {
                 trans_coeff_level = *abs_level * sign;
@@ -2298,17 +2359,48 @@ static inline int residual_coding_subblock(VVCLocalContext *lc, ResidualCoding *
                         trans_coeff_level = -trans_coeff_level;
                 }
             }
-            tb->coeffs[off] = trans_coeff_level;
+            set_coeff(tb, off, trans_coeff_level);
             tb->max_scan_x = FFMAX(xc, tb->max_scan_x);
             tb->max_scan_y = FFMAX(yc, tb->max_scan_y);
         }
-        if (rsh->sh_dep_quant_used_flag)
+        if (dep_quant)
             rc->qstate = qstate_translate_table[rc->qstate][*abs_level & 1];
     }
 
     return 0;
 }
 
+static av_always_inline int residual_coding_subblocks(VVCLocalContext *lc, ResidualCoding *rc,
+    const int dep_quant, const int chroma)
+{
+    for (int i = rc->last_sub_block; i >= 0; i--) {
+        int ret;
+        if (rc->log2_sb_w == 2 && rc->log2_sb_h == 2)
+            ret = residual_coding_subblock(lc, rc, i, dep_quant, chroma, 2, 2);
+        else
+            ret = residual_coding_subblock(lc, rc, i, dep_quant, chroma, rc->log2_sb_w, rc->log2_sb_h);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+#define RESIDUAL_CODING_SUBBLOCKS(name, dep_quant, chroma)                              \
+static int residual_coding_subblocks_ ## name(VVCLocalContext *lc, ResidualCoding *rc) \
+{                                                                                       \
+    return residual_coding_subblocks(lc, rc, dep_quant, chroma);                        \
+}
+
+RESIDUAL_CODING_SUBBLOCKS(luma,      0, 0)
+RESIDUAL_CODING_SUBBLOCKS(chroma,    0, 1)
+RESIDUAL_CODING_SUBBLOCKS(dq_luma,   1, 0)
+RESIDUAL_CODING_SUBBLOCKS(dq_chroma, 1, 1)
+
+static int (* const residual_coding_subblocks_fns[2][2])(VVCLocalContext *lc, ResidualCoding *rc) = {
+    { residual_coding_subblocks_luma,    residual_coding_subblocks_chroma    },
+    { residual_coding_subblocks_dq_luma, residual_coding_subblocks_dq_chroma },
+};
+
 static void derive_last_scan_pos(ResidualCoding *rc)
 {
     int xc, yc, xs, ys;
@@ -2377,6 +2469,7 @@ static int hls_residual_coding(VVCLocalContext *lc, TransformBlock *tb)
         log2_zo_tb_height = FFMIN(log2_tb_height, 5);
 
     init_residual_coding(lc, &rc, log2_zo_tb_width, log2_zo_tb_height, tb);
+    av_assert0(rc.num_sb_coeff <= MAX_SUB_BLOCK_SIZE * MAX_SUB_BLOCK_SIZE);
     last_significant_coeff_x_y_decode(&rc, lc, log2_zo_tb_width, log2_zo_tb_height);
     derive_last_scan_pos(&rc);
 
@@ -2389,19 +2482,16 @@ static int hls_residual_coding(VVCLocalContext *lc, TransformBlock *tb)
     if ((rc.last_sub_block > 0 || rc.last_scan_pos > 0 ) && !c_idx)
         lc->parse.mts_dc_only = 0;
 
-    memset(tb->coeffs, 0, tb->tb_width * tb->tb_height * sizeof(*tb->coeffs));
+    if (tb->coeffs32)
+        memset(tb->coeffs32, 0, tb->tb_width * tb->tb_height * sizeof(*tb->coeffs32));
+    else
+        memset(tb->coeffs, 0, tb->tb_width * tb->tb_height * sizeof(*tb->coeffs));
     memset(rc.abs_level, 0, tb->tb_width * tb->tb_height * sizeof(rc.abs_level[0]));
     memset(rc.sb_coded_flag, 0, rc.nb_sbs);
     memset(rc.abs_level_pass1, 0, tb->tb_width * tb->tb_height * sizeof(rc.abs_level_pass1[0]));
     memset(rc.sig_coeff_flag, 0, tb->tb_width * tb->tb_height * sizeof(rc.sig_coeff_flag[0]));
 
-    for (int i = rc.last_sub_block; i >= 0; i--) {
-        int ret = residual_coding_subblock(lc, &rc, i);
-        if (ret < 0)
-            return ret;
-    }
-
-    return 0;
+    return residual_coding_subblocks_fns[!!lc->sc->sh.r->sh_dep_quant_used_flag][!!c_idx](lc, &rc);
 }
 
 int ff_vvc_residual_coding(VVCLocalContext *lc, TransformBlock *tb)
@@ -265,11 +265,42 @@ static TransformBlock* add_tb(TransformUnit *tu, VVCLocalContext *lc,
 
     tb->c_idx = c_idx;
     tb->ts = 0;
-    tb->coeffs = lc->coeffs;
-    lc->coeffs += tb_width * tb_height;
+    tb->coeffs   = NULL;
+    tb->coeffs32 = NULL;
     return tb;
 }
 
+// Levels only need storage when the block is coded. They fit in 16 bits
+// unless sps_extended_precision_flag widens the transform range.
+static int alloc_tb_coeffs(VVCLocalContext *lc, TransformBlock *tb)
+{
+    VVCFrameContext *fc     = lc->fc;
+    const VVCSPS *sps       = fc->ps.sps;
+    const CodingUnit *cu    = lc->cu;
+    const int rx            = cu->x0 >> sps->ctb_log2_size_y;
+    const int ry            = cu->y0 >> sps->ctb_log2_size_y;
+    CTU *ctu                = fc->tab.ctus + ry * fc->ps.pps->ctb_width + rx;
+    const int wide          = sps->log2_transform_range > 15;
+    const int size          = FFALIGN(tb->tb_width * tb->tb_height << wide, 16);
+    CoeffBlock *blk         = ctu->coeff_blocks;
+
+    if (!blk || blk->used + size > COEFF_BLOCK_SIZE) {
+        blk = ff_refstruct_pool_get(fc->coeff_pool);
+        if (!blk)
+            return AVERROR(ENOMEM);
+        blk->used = 0;
+        blk->next = ctu->coeff_blocks;
+        ctu->coeff_blocks = blk;
+    }
+    if (wide)
+        tb->coeffs32 = (int *)(blk->coeffs + blk->used);
+    else
+        tb->coeffs   = blk->coeffs + blk->used;
+    blk->used += size;
+
+    return 0;
+}
+
 static uint8_t tu_y_coded_flag_decode(VVCLocalContext *lc, const int is_sbt_not_coded,
     const int sub_tu_index, const int is_isp, const int is_chroma_coded)
 {
@@ -389,6 +420,9 @@ static int hls_transform_unit(VVCLocalContext *lc, int x0, int y0,int tu_width,
                 !cu->sbt_flag && (is_chroma || !is_isp)) {
                 tb->ts = ff_vvc_transform_skip_flag(lc, is_chroma);
             }
+            ret = alloc_tb_coeffs(lc, tb);
+            if (ret < 0)
+                return ret;
             ret = ff_vvc_residual_coding(lc, tb);
             if (ret < 0)
                 return ret;
@@ -1687,20 +1721,6 @@ static void refine_regular_subblock(const VVCLocalContext *lc)
     }
 }
 
-static void fill_dmvr_info(const VVCFrameContext *fc, const int x0, const int y0,
-    const int width, const int height)
-{
-    const VVCPPS *pps = fc->ps.pps;
-    const int w = width >> MIN_PU_LOG2;
-
-    for (int y = y0 >> MIN_PU_LOG2; y < (y0 + height) >> MIN_PU_LOG2; y++) {
-        const int idx = pps->min_pu_width * y + (x0 >> MIN_PU_LOG2);
-        const MvField *mvf = fc->tab.mvf + idx;
-        MvField *dmvr_mvf  = fc->ref->tab_dmvr_mvf + idx;
-        memcpy(dmvr_mvf, mvf, sizeof(MvField) * w);
-    }
-}
-
 static int inter_data(VVCLocalContext *lc)
 {
     const CodingUnit *cu    = lc->cu;
@@ -1725,7 +1745,7 @@ static int inter_data(VVCLocalContext *lc)
         ff_vvc_update_hmvp(lc, mi);
     }
     if (!pu->dmvr_flag)
-        fill_dmvr_info(lc->fc, cu->x0, cu->y0, cu->cb_width, cu->cb_height);
+        ff_vvc_store_col_mvf(lc->fc, cu->x0, cu->y0, cu->cb_width, cu->cb_height);
     return ret;
 }
 
@@ -2423,13 +2443,41 @@ static void ctu_init_min_cb_tabs(const VVCFrameContext *fc, const int x0, const
     }
 }
 
-static void ctu_init_tabs(const VVCFrameContext *fc, const int rx, const int ry)
+static void ctu_init_col_tabs(const VVCFrameContext *fc, const int x0, const int y0)
+{
+    const int ctu_size = fc->ps.sps->ctb_size_y;
+
+    // intra CUs leave the collocated motion field untouched
+    ff_vvc_clear_col_mvf(fc, fc->ref->tab_col_mvf, x0, y0, ctu_size, ctu_size);
+}
+
+static void ctu_init_split_tabs(const VVCFrameContext *fc, const int x0, const int y0)
+{
+    const VVCPPS *pps  = fc->ps.pps;
+    const int ctu_size = fc->ps.sps->ctb_size_y;
+    const int x_end    = FFMIN(x0 + ctu_size, pps->width);
+    const int y_end    = FFMIN(y0 + ctu_size, pps->height);
+    const int w32      = AV_CEIL_RSHIFT(x_end, 5) - (x0 >> 5);
+    const int w64      = AV_CEIL_RSHIFT(x_end, 6) - (x0 >> 6);
+
+    for (int y = y0 >> 5; y < AV_CEIL_RSHIFT(y_end, 5); y++) {
+        const int off = y * pps->width32 + (x0 >> 5);
+        for (int i = LUMA; i <= CHROMA; i++)
+            memset(fc->tab.msm[i] + off, 0, w32);
+    }
+    for (int y = y0 >> 6; y < AV_CEIL_RSHIFT(y_end, 6); y++)
+        memset(fc->tab.ispmf + y * pps->width64 + (x0 >> 6), 0, w64);
+}
+
+void ff_vvc_ctu_init_tabs(const VVCFrameContext *fc, const int rx, const int ry)
 {
     const int x0 = rx * fc->ps.sps->ctb_size_y;
     const int y0 = ry * fc->ps.sps->ctb_size_y;
 
     ctu_init_min_cb_tabs(fc, x0, y0);
+    ctu_init_col_tabs(fc, x0, y0);
     ctu_init_tu_tabs(fc, x0, y0);
+    ctu_init_split_tabs(fc, x0, y0);
 }
 
 int ff_vvc_coding_tree_unit(VVCLocalContext *lc,
@@ -2440,7 +2488,6 @@ int ff_vvc_coding_tree_unit(VVCLocalContext *lc,
     const VVCPPS *pps           = fc->ps.pps;
     const int x_ctb             = rx << sps->ctb_log2_size_y;
     const int y_ctb             = ry << sps->ctb_log2_size_y;
-    const int ctb_size          = 1 << sps->ctb_log2_size_y << sps->ctb_log2_size_y;
     EntryPoint* ep              = lc->ep;
     int ret;
 
@@ -2450,10 +2497,9 @@ int ff_vvc_coding_tree_unit(VVCLocalContext *lc,
         ep->is_first_qg = ry == pps->ctb_to_row_bd[ry] || !ctu_idx;
     }
 
-    ctu_init_tabs(fc, rx, ry);
+    ff_vvc_ctu_init_tabs(fc, rx, ry);
 
-    lc->coeffs = fc->tab.coeffs + rs * ctb_size * VVC_MAX_SAMPLE_ARRAYS;
-    lc->cu     = NULL;
+    lc->cu = NULL;
 
     ff_vvc_cabac_init(lc, ctu_idx, rx, ry);
     ff_vvc_decode_neighbour(lc, x_ctb, y_ctb, rx, ry, rs);
@@ -2465,6 +2511,16 @@ int ff_vvc_coding_tree_unit(VVCLocalContext *lc,
     return 0;
 }
 
+int ff_vvc_subpic_edge_unfiltered(const VVCFrameContext *fc, const int rs0, const int rs1)
+{
+    const H266RawSPS *rsps = fc->ps.sps->r;
+    const int idx0         = fc->ps.pps->ctb_to_subpic[rs0];
+    const int idx1         = fc->ps.pps->ctb_to_subpic[rs1];
+
+    return idx0 != idx1 && (!rsps->sps_loop_filter_across_subpic_enabled_flag[idx0] ||
+        !rsps->sps_loop_filter_across_subpic_enabled_flag[idx1]);
+}
+
 void ff_vvc_decode_neighbour(VVCLocalContext *lc, const int x_ctb, const int y_ctb,
     const int rx, const int ry, const int rs)
 {
@@ -2487,6 +2543,10 @@ void ff_vvc_decode_neighbour(VVCLocalContext *lc, const int x_ctb, const int y_c
         lc->boundary_flags |= BOUNDARY_UPPER_TILE;
     if (ry > 0 && fc->tab.slice_idx[rs] != fc->tab.slice_idx[rs - fc->ps.pps->ctb_width])
         lc->boundary_flags |= BOUNDARY_UPPER_SLICE;
+    if (rx > 0 && ff_vvc_subpic_edge_unfiltered(fc, rs, rs - 1))
+        lc->boundary_flags |= BOUNDARY_LEFT_SUBPIC;
+    if (ry > 0 && ff_vvc_subpic_edge_unfiltered(fc, rs, rs - fc->ps.pps->ctb_width))
+        lc->boundary_flags |= BOUNDARY_UPPER_SUBPIC;
     lc->ctb_left_flag = rx > 0 && !(lc->boundary_flags & BOUNDARY_LEFT_TILE);
     lc->ctb_up_flag   = ry > 0 && !(lc->boundary_flags & BOUNDARY_UPPER_TILE) && !(lc->boundary_flags & BOUNDARY_UPPER_SLICE);
     lc->ctb_up_right_flag = lc->ctb_up_flag && (fc->ps.pps->ctb_to_col_bd[rx] == fc->ps.pps->ctb_to_col_bd[rx + 1]) &&
@@ -2527,6 +2587,12 @@ void ff_vvc_ctu_free_cus(CTU *ctu)
 
         ff_refstruct_unref(&cu);
     }
+
+    while (ctu->coeff_blocks) {
+        CoeffBlock *blk = ctu->coeff_blocks;
+        ctu->coeff_blocks = blk->next;
+        ff_refstruct_unref(&blk);
+    }
 }
 
 int ff_vvc_get_qPy(const VVCFrameContext *fc, const int xc, const int yc)
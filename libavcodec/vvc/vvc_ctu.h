@@ -155,7 +155,8 @@ typedef struct TransformBlock {
     int bd_shift;
     int bd_offset;
 
-    int *coeffs;
+    int16_t *coeffs;                                ///< coefficient levels, NULL if coeffs32 is used
+    int *coeffs32;                                  ///< coefficient levels, when log2_transform_range > 15
 } TransformBlock;
 
 typedef enum VVCTreeType {
@@ -201,6 +202,16 @@ typedef struct MvField {
     uint8_t ciip_flag;              ///< ciip_flag
 } MvField;
 
+/**
+ * Motion of an 8x8 block kept with the frame for the temporal candidates of
+ * later pictures, sampled at its top-left 4x4 block.
+ */
+typedef struct ColMvField {
+    Mv mv[2];                       ///< compressed as in 8.5.2.15
+    int8_t  ref_idx[2];
+    uint8_t pred_flag;
+} ColMvField;
+
 typedef struct DMVRInfo {
     DECLARE_ALIGNED(8, Mv, mv)[2];  ///< mvL0, vvL1
     uint8_t dmvr_enabled;
@@ -324,8 +335,19 @@ typedef struct CodingUnit {
     struct CodingUnit *next;                        ///< RefStruct reference
 } CodingUnit;
 
+// large enough for one 64x64 transform block of int32_t levels
+#define COEFF_BLOCK_SIZE        (MAX_TB_SIZE * MAX_TB_SIZE * 2)
+
+// backing storage for the coefficient levels of a CTU, handed out per transform block
+typedef struct CoeffBlock {
+    int16_t coeffs[COEFF_BLOCK_SIZE];
+    int used;                                       ///< number of int16_t in use
+    struct CoeffBlock *next;                        ///< RefStruct reference
+} CoeffBlock;
+
 typedef struct CTU {
     CodingUnit *cus;
+    CoeffBlock *coeff_blocks;                       ///< RefStruct reference, most recent first
     int max_y[2][VVC_MAX_REF_ENTRIES];
     int max_y_idx[2];
     int has_dmvr;
@@ -419,6 +441,8 @@ typedef struct VVCLocalContext {
 #define BOUNDARY_LEFT_TILE      (1 << 1)
 #define BOUNDARY_UPPER_SLICE    (1 << 2)
 #define BOUNDARY_UPPER_TILE     (1 << 3)
+#define BOUNDARY_LEFT_SUBPIC    (1 << 4)    ///< and not filtered across, see ff_vvc_subpic_edge_unfiltered()
+#define BOUNDARY_UPPER_SUBPIC   (1 << 5)    ///< and not filtered across, see ff_vvc_subpic_edge_unfiltered()
     /* properties of the boundary of the current CTB for the purposes
      * of the deblocking filter */
     int boundary_flags;
@@ -426,7 +450,6 @@ typedef struct VVCLocalContext {
     SliceContext *sc;
     VVCFrameContext *fc;
     EntryPoint *ep;
-    int *coeffs;
 } VVCLocalContext;
 
 typedef struct VVCAllowedSplit {
@@ -470,6 +493,23 @@ typedef struct ALFParams {
  */
 int ff_vvc_coding_tree_unit(VVCLocalContext *lc, int ctu_idx, int rs, int rx, int ry);
 
+/**
+ * clear the per-picture tables covered by a CTU, parsing a CTU does it itself
+ * @param fc frame context
+ * @param rx raster order x for the CTU.
+ * @param ry raster order y for the CTU.
+ */
+void ff_vvc_ctu_init_tabs(const VVCFrameContext *fc, int rx, int ry);
+
+/**
+ * Whether the in-loop filters stop at the edge between two CTUs, since they
+ * are in different subpictures and one of them is not filtered across its
+ * edges (sps_loop_filter_across_subpic_enabled_flag).
+ * @param rs0 raster order for the first CTU.
+ * @param rs1 raster order for the second CTU.
+ */
+int ff_vvc_subpic_edge_unfiltered(const VVCFrameContext *fc, int rs0, int rs1);
+
 //utils
 void ff_vvc_set_neighbour_available(VVCLocalContext *lc, int x0, int y0, int w, int h);
 void ff_vvc_decode_neighbour(VVCLocalContext *lc, int x_ctb, int y_ctb, int rx, int ry, int rs);
@@ -168,7 +168,10 @@ void ff_vvc_sao_filter(VVCLocalContext *lc, int x, int y)
     const uint8_t lfase          = fc->ps.pps->r->pps_loop_filter_across_slices_enabled_flag;
     const uint8_t no_tile_filter = fc->ps.pps->r->num_tiles_in_pic > 1 &&
                                !fc->ps.pps->r->pps_loop_filter_across_tiles_enabled_flag;
-    const uint8_t restore        = no_tile_filter || !lfase;
+    const uint8_t has_subpics    = fc->ps.sps->r->sps_num_subpics_minus1 > 0;
+    const uint8_t restore        = no_tile_filter || !lfase || has_subpics;
+    const int rs                 = y_ctb * fc->ps.pps->ctb_width + x_ctb;
+    const int ctb_width          = fc->ps.pps->ctb_width;
     uint8_t left_tile_edge   = 0;
     uint8_t right_tile_edge  = 0;
     uint8_t up_tile_edge     = 0;
@@ -182,31 +185,39 @@ void ff_vvc_sao_filter(VVCLocalContext *lc, int x, int y)
     if (restore) {
         if (!edges[LEFT]) {
             left_tile_edge  = no_tile_filter && fc->ps.pps->ctb_to_col_bd[x_ctb] == x_ctb;
-            vert_edge[0]    = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb - 1, y_ctb)) || left_tile_edge;
+            vert_edge[0]    = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb - 1, y_ctb)) || left_tile_edge ||
+                              ff_vvc_subpic_edge_unfiltered(fc, rs, rs - 1);
         }
         if (!edges[RIGHT]) {
             right_tile_edge = no_tile_filter && fc->ps.pps->ctb_to_col_bd[x_ctb] != fc->ps.pps->ctb_to_col_bd[x_ctb + 1];
-            vert_edge[1]    = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb + 1, y_ctb)) || right_tile_edge;
+            vert_edge[1]    = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb + 1, y_ctb)) || right_tile_edge ||
+                              ff_vvc_subpic_edge_unfiltered(fc, rs, rs + 1);
         }
         if (!edges[TOP]) {
             up_tile_edge     = no_tile_filter && fc->ps.pps->ctb_to_row_bd[y_ctb] == y_ctb;
-            horiz_edge[0]    = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb, y_ctb - 1)) || up_tile_edge;
+            horiz_edge[0]    = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb, y_ctb - 1)) || up_tile_edge ||
+                               ff_vvc_subpic_edge_unfiltered(fc, rs, rs - ctb_width);
         }
         if (!edges[BOTTOM]) {
             bottom_tile_edge = no_tile_filter && fc->ps.pps->ctb_to_row_bd[y_ctb] != fc->ps.pps->ctb_to_row_bd[y_ctb + 1];
-            horiz_edge[1]    = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb, y_ctb + 1)) || bottom_tile_edge;
+            horiz_edge[1]    = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb, y_ctb + 1)) || bottom_tile_edge ||
+                               ff_vvc_subpic_edge_unfiltered(fc, rs, rs + ctb_width);
         }
         if (!edges[LEFT] && !edges[TOP]) {
-            diag_edge[0] = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb - 1, y_ctb - 1)) || left_tile_edge || up_tile_edge;
+            diag_edge[0] = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb - 1, y_ctb - 1)) || left_tile_edge || up_tile_edge ||
+                           ff_vvc_subpic_edge_unfiltered(fc, rs, rs - ctb_width - 1);
         }
         if (!edges[TOP] && !edges[RIGHT]) {
-            diag_edge[1] = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb + 1, y_ctb - 1)) || right_tile_edge || up_tile_edge;
+            diag_edge[1] = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb + 1, y_ctb - 1)) || right_tile_edge || up_tile_edge ||
+                           ff_vvc_subpic_edge_unfiltered(fc, rs, rs - ctb_width + 1);
         }
         if (!edges[RIGHT] && !edges[BOTTOM]) {
-            diag_edge[2] = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb + 1, y_ctb + 1)) || right_tile_edge || bottom_tile_edge;
+            diag_edge[2] = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb + 1, y_ctb + 1)) || right_tile_edge || bottom_tile_edge ||
+                           ff_vvc_subpic_edge_unfiltered(fc, rs, rs + ctb_width + 1);
         }
         if (!edges[LEFT] && !edges[BOTTOM]) {
-            diag_edge[3] = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb - 1, y_ctb + 1)) || left_tile_edge || bottom_tile_edge;
+            diag_edge[3] = (!lfase && CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb - 1, y_ctb + 1)) || left_tile_edge || bottom_tile_edge ||
+                           ff_vvc_subpic_edge_unfiltered(fc, rs, rs + ctb_width - 1);
         }
     }
 
@@ -508,6 +519,8 @@ static void vvc_deblock_bs_luma_vertical(const VVCLocalContext *lc,
             (x0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0) ||
             (!fc->ps.pps->r->pps_loop_filter_across_tiles_enabled_flag &&
             lc->boundary_flags & BOUNDARY_LEFT_TILE &&
+            (x0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0) ||
+            (lc->boundary_flags & BOUNDARY_LEFT_SUBPIC &&
             (x0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0)))
         boundary_left = 0;
 
@@ -590,6 +603,8 @@ static void vvc_deblock_bs_luma_horizontal(const VVCLocalContext *lc,
             (y0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0) ||
             (!fc->ps.pps->r->pps_loop_filter_across_tiles_enabled_flag &&
             lc->boundary_flags & BOUNDARY_UPPER_TILE &&
+            (y0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0) ||
+            (lc->boundary_flags & BOUNDARY_UPPER_SUBPIC &&
             (y0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0)))
         boundary_upper = 0;
 
@@ -658,6 +673,8 @@ static void vvc_deblock_bs_chroma_vertical(const VVCLocalContext *lc,
           (x0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0) ||
          (!fc->ps.pps->r->pps_loop_filter_across_tiles_enabled_flag &&
           lc->boundary_flags & BOUNDARY_LEFT_TILE &&
+          (x0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0) ||
+         (lc->boundary_flags & BOUNDARY_LEFT_SUBPIC &&
           (x0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0)))
         boundary_left = 0;
 
@@ -713,6 +730,8 @@ static void vvc_deblock_bs_chroma_horizontal(const VVCLocalContext *lc,
             (y0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0) ||
             (!fc->ps.pps->r->pps_loop_filter_across_tiles_enabled_flag &&
                 lc->boundary_flags & BOUNDARY_UPPER_TILE &&
+                (y0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0) ||
+            (lc->boundary_flags & BOUNDARY_UPPER_SUBPIC &&
                 (y0 % (1 << fc->ps.sps->ctb_log2_size_y)) == 0)))
         boundary_upper = 0;
 
@@ -1279,6 +1298,14 @@ void ff_vvc_alf_filter(VVCLocalContext *lc, const int x0, const int y0)
         edges[BOTTOM] = edges[BOTTOM] || CTB(fc->tab.slice_idx, x_ctb, y_ctb) != CTB(fc->tab.slice_idx, x_ctb, y_ctb + 1);
     }
 
+    if (fc->ps.sps->r->sps_num_subpics_minus1) {
+        const int rs  = y_ctb * pps->ctb_width + x_ctb;
+        edges[LEFT]   = edges[LEFT] || (lc->boundary_flags & BOUNDARY_LEFT_SUBPIC);
+        edges[TOP]    = edges[TOP] || (lc->boundary_flags & BOUNDARY_UPPER_SUBPIC);
+        edges[RIGHT]  = edges[RIGHT] || ff_vvc_subpic_edge_unfiltered(fc, rs, rs + 1);
+        edges[BOTTOM] = edges[BOTTOM] || ff_vvc_subpic_edge_unfiltered(fc, rs, rs + pps->ctb_width);
+    }
+
     for (int c_idx = 0; c_idx < c_end; c_idx++) {
         const int hs = fc->ps.sps->hshift[c_idx];
         const int vs = fc->ps.sps->vshift[c_idx];
@@ -30,25 +30,65 @@
 #define PROF_TEMP_OFFSET (MAX_PB_SIZE + 32)
 static const int bcw_w_lut[] = {4, 5, 3, 10, -2};
 
-static int emulated_edge(const VVCFrameContext *fc, uint8_t *dst, const uint8_t **src, ptrdiff_t *src_stride,
+/*
+ * Area the reference samples are taken from, with the samples that may be
+ * read past its edges without emulation.
+ */
+typedef struct RefArea {
+    int x, y;
+    int width, height;
+    int pad_x, pad_y;
+} RefArea;
+
+// 8.5.6.3.2 and 8.5.6.3.4, the reference samples of a subpicture treated as a picture are clipped to it
+static void ref_area_init(RefArea *a, const VVCLocalContext *lc, const int is_luma)
+{
+    const VVCFrameContext *fc = lc->fc;
+    const VVCSPS *sps         = fc->ps.sps;
+    const VVCPPS *pps         = fc->ps.pps;
+    const H266RawSPS *rsps    = sps->r;
+    const int idx             = lc->sc->sh.r->curr_subpic_idx;
+    const int hs              = is_luma ? 0 : sps->hshift[1];
+    const int vs              = is_luma ? 0 : sps->vshift[1];
+
+    if (rsps->sps_num_subpics_minus1 && rsps->sps_subpic_treated_as_pic_flag[idx]) {
+        // the padding of the reference frames is only around the picture
+        a->x      = pps->subpic_x[idx] >> hs;
+        a->y      = pps->subpic_y[idx] >> vs;
+        a->width  = pps->subpic_width[idx]  >> hs;
+        a->height = pps->subpic_height[idx] >> vs;
+        a->pad_x  = 0;
+        a->pad_y  = 0;
+    } else {
+        a->x      = 0;
+        a->y      = 0;
+        a->width  = pps->width  >> hs;
+        a->height = pps->height >> vs;
+        a->pad_x  = fc->ref_padding >> hs;
+        a->pad_y  = fc->ref_padding >> vs;
+    }
+}
+
+static int emulated_edge(const VVCLocalContext *lc, uint8_t *dst, const uint8_t **src, ptrdiff_t *src_stride,
     const int x_off, const int y_off, const int block_w, const int block_h, const int is_luma)
 {
+    const VVCFrameContext *fc = lc->fc;
     const int extra_before = is_luma ? LUMA_EXTRA_BEFORE : CHROMA_EXTRA_BEFORE;
     const int extra_after  = is_luma ? LUMA_EXTRA_AFTER : CHROMA_EXTRA_AFTER;
     const int extra        = is_luma ? LUMA_EXTRA : CHROMA_EXTRA;
-    const int pic_width    = is_luma ? fc->ps.pps->width  : (fc->ps.pps->width >> fc->ps.sps->hshift[1]);
-    const int pic_height   = is_luma ? fc->ps.pps->height : (fc->ps.pps->height >> fc->ps.sps->vshift[1]);
+    RefArea a;
 
-    if (x_off < extra_before || y_off < extra_before ||
-        x_off >= pic_width - block_w - extra_after ||
-        y_off >= pic_height - block_h - extra_after) {
+    ref_area_init(&a, lc, is_luma);
+    if (x_off < a.x + extra_before - a.pad_x || y_off < a.y + extra_before - a.pad_y ||
+        x_off >= a.x + a.width  + a.pad_x - block_w - extra_after ||
+        y_off >= a.y + a.height + a.pad_y - block_h - extra_after) {
         const ptrdiff_t edge_emu_stride = EDGE_EMU_BUFFER_STRIDE << fc->ps.sps->pixel_shift;
         int offset     = extra_before * *src_stride      + (extra_before << fc->ps.sps->pixel_shift);
         int buf_offset = extra_before * edge_emu_stride + (extra_before << fc->ps.sps->pixel_shift);
 
         fc->vdsp.emulated_edge_mc(dst, *src - offset, edge_emu_stride, *src_stride,
-            block_w + extra, block_h + extra, x_off - extra_before, y_off - extra_before,
-            pic_width, pic_height);
+            block_w + extra, block_h + extra, x_off - a.x - extra_before, y_off - a.y - extra_before,
+            a.width, a.height);
 
         *src = dst + buf_offset;
         *src_stride = edge_emu_stride;
@@ -57,28 +97,29 @@ static int emulated_edge(const VVCFrameContext *fc, uint8_t *dst, const uint8_t
     return 0;
 }
 
-static void emulated_edge_dmvr(const VVCFrameContext *fc, uint8_t *dst, const uint8_t **src, ptrdiff_t *src_stride,
+static void emulated_edge_dmvr(const VVCLocalContext *lc, uint8_t *dst, const uint8_t **src, ptrdiff_t *src_stride,
     const int x_sb, const int y_sb, const int x_off, const int y_off, const int block_w, const int block_h, const int is_luma)
 {
+    const VVCFrameContext *fc = lc->fc;
     const int extra_before = is_luma ? LUMA_EXTRA_BEFORE : CHROMA_EXTRA_BEFORE;
     const int extra_after  = is_luma ? LUMA_EXTRA_AFTER : CHROMA_EXTRA_AFTER;
     const int extra        = is_luma ? LUMA_EXTRA : CHROMA_EXTRA;
-    const int pic_width    = is_luma ? fc->ps.pps->width  : (fc->ps.pps->width >> fc->ps.sps->hshift[1]);
-    const int pic_height   = is_luma ? fc->ps.pps->height : (fc->ps.pps->height >> fc->ps.sps->vshift[1]);
+    RefArea a;
 
-    if (x_off < extra_before || y_off < extra_before ||
-        x_off >= pic_width - block_w - extra_after ||
-        y_off >= pic_height - block_h - extra_after||
+    ref_area_init(&a, lc, is_luma);
+    if (x_off < a.x + extra_before - a.pad_x || y_off < a.y + extra_before - a.pad_y ||
+        x_off >= a.x + a.width  + a.pad_x - block_w - extra_after ||
+        y_off >= a.y + a.height + a.pad_y - block_h - extra_after||
         (x_off != x_sb || y_off !=  y_sb)) {
         const int ps                    = fc->ps.sps->pixel_shift;
         const ptrdiff_t edge_emu_stride = EDGE_EMU_BUFFER_STRIDE << ps;
         const int offset                = extra_before * *src_stride + (extra_before << ps);
         const int buf_offset            = extra_before * edge_emu_stride + (extra_before << ps);
 
-        const int start_x               = FFMIN(FFMAX(x_sb - extra_before, 0), pic_width  - 1);
-        const int start_y               = FFMIN(FFMAX(y_sb - extra_before, 0), pic_height - 1);
-        const int width                 = FFMAX(FFMIN(pic_width, x_sb + block_w + extra_after) - start_x, 1);
-        const int height                = FFMAX(FFMIN(pic_height, y_sb + block_h + extra_after) - start_y, 1);
+        const int start_x               = FFMIN(FFMAX(x_sb - extra_before, a.x), a.x + a.width  - 1);
+        const int start_y               = FFMIN(FFMAX(y_sb - extra_before, a.y), a.y + a.height - 1);
+        const int width                 = FFMAX(FFMIN(a.x + a.width,  x_sb + block_w + extra_after) - start_x, 1);
+        const int height                = FFMAX(FFMIN(a.y + a.height, y_sb + block_h + extra_after) - start_y, 1);
 
         fc->vdsp.emulated_edge_mc(dst, *src - offset, edge_emu_stride, *src_stride, block_w + extra, block_h + extra,
             x_off - start_x - extra_before, y_off - start_y - extra_before, width, height);
@@ -88,21 +129,22 @@ static void emulated_edge_dmvr(const VVCFrameContext *fc, uint8_t *dst, const ui
    }
 }
 
-static void emulated_edge_bilinear(const VVCFrameContext *fc, uint8_t *dst, const uint8_t **src, ptrdiff_t *src_stride,
+static void emulated_edge_bilinear(const VVCLocalContext *lc, uint8_t *dst, const uint8_t **src, ptrdiff_t *src_stride,
     const int x_off, const int y_off, const int block_w, const int block_h)
 {
-    int pic_width   = fc->ps.pps->width;
-    int pic_height  = fc->ps.pps->height;
+    const VVCFrameContext *fc = lc->fc;
+    RefArea a;
 
-    if (x_off < BILINEAR_EXTRA_BEFORE || y_off < BILINEAR_EXTRA_BEFORE ||
-        x_off >= pic_width - block_w - BILINEAR_EXTRA_AFTER ||
-        y_off >= pic_height - block_h - BILINEAR_EXTRA_AFTER) {
+    ref_area_init(&a, lc, 1);
+    if (x_off < a.x + BILINEAR_EXTRA_BEFORE - a.pad_x || y_off < a.y + BILINEAR_EXTRA_BEFORE - a.pad_y ||
+        x_off >= a.x + a.width  + a.pad_x - block_w - BILINEAR_EXTRA_AFTER ||
+        y_off >= a.y + a.height + a.pad_y - block_h - BILINEAR_EXTRA_AFTER) {
         const ptrdiff_t edge_emu_stride = EDGE_EMU_BUFFER_STRIDE << fc->ps.sps->pixel_shift;
         const int offset                = BILINEAR_EXTRA_BEFORE * *src_stride + (BILINEAR_EXTRA_BEFORE << fc->ps.sps->pixel_shift);
         const int buf_offset            = BILINEAR_EXTRA_BEFORE * edge_emu_stride + (BILINEAR_EXTRA_BEFORE << fc->ps.sps->pixel_shift);
 
         fc->vdsp.emulated_edge_mc(dst, *src - offset, edge_emu_stride, *src_stride, block_w + BILINEAR_EXTRA, block_h + BILINEAR_EXTRA,
-            x_off - BILINEAR_EXTRA_BEFORE, y_off - BILINEAR_EXTRA_BEFORE,  pic_width, pic_height);
+            x_off - a.x - BILINEAR_EXTRA_BEFORE, y_off - a.y - BILINEAR_EXTRA_BEFORE, a.width, a.height);
 
         *src = dst + buf_offset;
         *src_stride = edge_emu_stride;
@@ -111,19 +153,19 @@ static void emulated_edge_bilinear(const VVCFrameContext *fc, uint8_t *dst, cons
 
 
 #define EMULATED_EDGE_LUMA(dst, src, src_stride, x_off, y_off)                      \
-    emulated_edge(fc, dst, src, src_stride, x_off, y_off, block_w, block_h, 1)
+    emulated_edge(lc, dst, src, src_stride, x_off, y_off, block_w, block_h, 1)
 
 #define EMULATED_EDGE_CHROMA(dst, src, src_stride, x_off, y_off)                    \
-    emulated_edge(fc, dst, src, src_stride, x_off, y_off, block_w, block_h, 0)
+    emulated_edge(lc, dst, src, src_stride, x_off, y_off, block_w, block_h, 0)
 
 #define EMULATED_EDGE_DMVR_LUMA(dst, src, src_stride, x_sb, y_sb, x_off, y_off)     \
-    emulated_edge_dmvr(fc, dst, src, src_stride, x_sb, y_sb, x_off, y_off, block_w, block_h, 1)
+    emulated_edge_dmvr(lc, dst, src, src_stride, x_sb, y_sb, x_off, y_off, block_w, block_h, 1)
 
 #define EMULATED_EDGE_DMVR_CHROMA(dst, src, src_stride, x_sb, y_sb, x_off, y_off)   \
-    emulated_edge_dmvr(fc, dst, src, src_stride, x_sb, y_sb, x_off, y_off, block_w, block_h, 0)
+    emulated_edge_dmvr(lc, dst, src, src_stride, x_sb, y_sb, x_off, y_off, block_w, block_h, 0)
 
 #define EMULATED_EDGE_BILINEAR(dst, src, src_stride, x_off, y_off)                  \
-    emulated_edge_bilinear(fc, dst, src, src_stride, x_off, y_off, pred_w, pred_h)
+    emulated_edge_bilinear(lc, dst, src, src_stride, x_off, y_off, pred_w, pred_h)
 
 // part of 8.5.6.6 Weighted sample prediction process
 static int derive_weight_uni(int *denom, int *wx, int *ox,
@@ -747,20 +789,6 @@ static void dmvr_mv_refine(VVCLocalContext *lc, MvField *mvf, MvField *orig_mv,
     }
 }
 
-static void set_dmvr_info(VVCFrameContext *fc, const int x0, const int y0,
-    const int width, const int height, const MvField *mvf)
-
-{
-    const VVCPPS *pps = fc->ps.pps;
-
-    for (int y = y0; y < y0 + height; y += MIN_PU_SIZE) {
-        for (int x = x0; x < x0 + width; x += MIN_PU_SIZE) {
-            const int idx = pps->min_pu_width * (y >> MIN_PU_LOG2) + (x >> MIN_PU_LOG2);
-            fc->ref->tab_dmvr_mvf[idx] = *mvf;
-        }
-    }
-}
-
 static void derive_sb_mv(VVCLocalContext *lc, MvField *mv, MvField *orig_mv, int *sb_bdof_flag,
     const int x0, const int y0, const int sbw, const int sbh)
 {
@@ -775,7 +803,7 @@ static void derive_sb_mv(VVCLocalContext *lc, MvField *mv, MvField *orig_mv, int
         if (pred_get_refs(lc, ref, mv) < 0)
             return;
         dmvr_mv_refine(lc, mv, orig_mv, sb_bdof_flag, ref[0]->frame, ref[1]->frame, x0, y0, sbw, sbh);
-        set_dmvr_info(fc, x0, y0, sbw, sbh, mv);
+        ff_vvc_set_col_mvf(fc, x0, y0, sbw, sbh, mv);
     }
 }
 
@@ -62,7 +62,7 @@ static int derive_ilfnst_pred_mode_intra(const VVCLocalContext *lc, const Transf
 }
 
 //8.7.4 Transformation process for scaled transform coefficients
-static void ilfnst_transform(const VVCLocalContext *lc, TransformBlock *tb)
+static void ilfnst_transform(const VVCLocalContext *lc, TransformBlock *tb, int *coeffs)
 {
     const VVCSPS *sps           = lc->fc->ps.sps;
     const CodingUnit *cu        = lc->cu;
@@ -79,12 +79,12 @@ static void ilfnst_transform(const VVCLocalContext *lc, TransformBlock *tb)
     for (int x = 0; x < non_zero_size; x++) {
         int xc = ff_vvc_diag_scan_x[2][2][x];
         int yc = ff_vvc_diag_scan_y[2][2][x];
-        u[x] = tb->coeffs[w * yc + xc];
+        u[x] = coeffs[w * yc + xc];
     }
     ff_vvc_inv_lfnst_1d(v, u, non_zero_size, n_lfnst_out_size, pred_mode_intra,
                         cu->lfnst_idx, sps->log2_transform_range);
     if (transpose) {
-        int *dst = tb->coeffs;
+        int *dst = coeffs;
         const int *src = v;
         if (n_lfnst_size == 4) {
             for (int y = 0; y < 4; y++) {
@@ -113,7 +113,7 @@ static void ilfnst_transform(const VVCLocalContext *lc, TransformBlock *tb)
         }
 
     } else {
-        int *dst = tb->coeffs;
+        int *dst = coeffs;
         const int *src = v;
         for (int y = 0; y < n_lfnst_size; y++) {
             int size = (y < 4) ? n_lfnst_size : 4;
@@ -164,7 +164,7 @@ static void derive_transform_type(const VVCFrameContext *fc, const VVCLocalConte
 }
 
 static void add_residual_for_joint_coding_chroma(VVCLocalContext *lc,
-    const TransformUnit *tu, TransformBlock *tb, const int chroma_scale)
+    const TransformUnit *tu, TransformBlock *tb, int *coeffs, const int chroma_scale)
 {
     const VVCFrameContext *fc  = lc->fc;
     const CodingUnit *cu = lc->cu;
@@ -177,11 +177,11 @@ static void add_residual_for_joint_coding_chroma(VVCLocalContext *lc,
     uint8_t *dst = &fc->frame->data[c_idx][(tb->y0 >> vs) * stride +
                                           ((tb->x0 >> hs) << fc->ps.sps->pixel_shift)];
     if (chroma_scale) {
-        fc->vvcdsp.itx.pred_residual_joint(tb->coeffs, tb->tb_width, tb->tb_height, c_sign, shift);
-        fc->vvcdsp.intra.lmcs_scale_chroma(lc, tb->coeffs, tb->coeffs, tb->tb_width, tb->tb_height, cu->x0, cu->y0);
-        fc->vvcdsp.itx.add_residual(dst, tb->coeffs, tb->tb_width, tb->tb_height, stride);
+        fc->vvcdsp.itx.pred_residual_joint(coeffs, tb->tb_width, tb->tb_height, c_sign, shift);
+        fc->vvcdsp.intra.lmcs_scale_chroma(lc, coeffs, coeffs, tb->tb_width, tb->tb_height, cu->x0, cu->y0);
+        fc->vvcdsp.itx.add_residual(dst, coeffs, tb->tb_width, tb->tb_height, stride);
     } else {
-        fc->vvcdsp.itx.add_residual_joint(dst, tb->coeffs, tb->tb_width, tb->tb_height, stride, c_sign, shift);
+        fc->vvcdsp.itx.add_residual_joint(dst, coeffs, tb->tb_width, tb->tb_height, stride, c_sign, shift);
     }
 }
 
@@ -394,7 +394,7 @@ static av_always_inline int scale_coeff(const TransformBlock *tb, int coeff,
     return coeff;
 }
 
-static void dequant(const VVCLocalContext *lc, const TransformUnit *tu, TransformBlock *tb)
+static void dequant(const VVCLocalContext *lc, const TransformUnit *tu, TransformBlock *tb, int *coeffs)
 {
     uint8_t tmp[MAX_TB_SIZE * MAX_TB_SIZE];
     const H266RawSliceHeader *rsh   = lc->sc->sh.r;
@@ -407,7 +407,7 @@ static void dequant(const VVCLocalContext *lc, const TransformUnit *tu, Transfor
 
     for (int y = tb->min_scan_y; y <= tb->max_scan_y; y++) {
         for (int x = tb->min_scan_x; x <= tb->max_scan_x; x++) {
-            int *coeff = tb->coeffs + y * tb->tb_width + x;
+            int *coeff = coeffs + y * tb->tb_width + x;
 
             if (*coeff)
                 *coeff = scale_coeff(tb, *coeff, scale, *scale_m, sps->log2_transform_range);
@@ -416,12 +416,12 @@ static void dequant(const VVCLocalContext *lc, const TransformUnit *tu, Transfor
     }
 }
 
-static void transform_bdpcm(TransformBlock *tb, const VVCLocalContext *lc, const CodingUnit *cu)
+static void transform_bdpcm(TransformBlock *tb, int *coeffs, const VVCLocalContext *lc, const CodingUnit *cu)
 {
     const VVCSPS *sps        = lc->fc->ps.sps;
     const IntraPredMode mode = tb->c_idx ? cu->intra_pred_mode_c : cu->intra_pred_mode_y;
     const int vertical       = mode == INTRA_VERT;
-    lc->fc->vvcdsp.itx.transform_bdpcm(tb->coeffs, tb->tb_width, tb->tb_height,
+    lc->fc->vvcdsp.itx.transform_bdpcm(coeffs, tb->tb_width, tb->tb_height,
                                        vertical, sps->log2_transform_range);
     if (vertical)
         tb->max_scan_y = tb->tb_height - 1;
@@ -429,6 +429,19 @@ static void transform_bdpcm(TransformBlock *tb, const VVCLocalContext *lc, const
         tb->max_scan_x = tb->tb_width - 1;
 }
 
+// widen the parsed levels into the buffer the transform works in place on
+static void load_coeffs(int *coeffs, const TransformBlock *tb)
+{
+    const int n = tb->tb_width * tb->tb_height;
+
+    if (tb->coeffs32) {
+        memcpy(coeffs, tb->coeffs32, n * sizeof(*coeffs));
+    } else {
+        for (int i = 0; i < n; i++)
+            coeffs[i] = tb->coeffs[i];
+    }
+}
+
 static void itransform(VVCLocalContext *lc, TransformUnit *tu, const int tu_idx, const int target_ch_type)
 {
     const VVCFrameContext *fc   = lc->fc;
@@ -437,6 +450,7 @@ static void itransform(VVCLocalContext *lc, TransformUnit *tu, const int tu_idx,
     const CodingUnit *cu        = lc->cu;
     const int ps                = fc->ps.sps->pixel_shift;
     DECLARE_ALIGNED(32, int, temp)[MAX_TB_SIZE * MAX_TB_SIZE];
+    DECLARE_ALIGNED(32, int, coeffs)[MAX_TB_SIZE * MAX_TB_SIZE];
 
     for (int i = 0; i < tu->nb_tbs; i++) {
         TransformBlock *tb  = &tu->tbs[i];
@@ -452,27 +466,28 @@ static void itransform(VVCLocalContext *lc, TransformUnit *tu, const int tu_idx,
             const int vs            = sps->vshift[c_idx];
             uint8_t *dst            = &fc->frame->data[c_idx][(tb->y0 >> vs) * stride + ((tb->x0 >> hs) << ps)];
 
+            load_coeffs(coeffs, tb);
             if (cu->bdpcm_flag[tb->c_idx])
-                transform_bdpcm(tb, lc, cu);
-            dequant(lc, tu, tb);
+                transform_bdpcm(tb, coeffs, lc, cu);
+            dequant(lc, tu, tb, coeffs);
             if (!tb->ts) {
                 enum TxType trh, trv;
 
                 if (cu->apply_lfnst_flag[c_idx])
-                    ilfnst_transform(lc, tb);
+                    ilfnst_transform(lc, tb, coeffs);
                 derive_transform_type(fc, lc, tb, &trh, &trv);
-                fc->vvcdsp.itx.itx[trh][trv][av_log2(w)][av_log2(h)](tb->coeffs,
+                fc->vvcdsp.itx.itx[trh][trv][av_log2(w)][av_log2(h)](coeffs,
                     tb->max_scan_x + 1, tb->max_scan_y + 1, sps->log2_transform_range, sps->bit_depth);
             }
 
             if (chroma_scale)
-                fc->vvcdsp.intra.lmcs_scale_chroma(lc, temp, tb->coeffs, w, h, cu->x0, cu->y0);
+                fc->vvcdsp.intra.lmcs_scale_chroma(lc, temp, coeffs, w, h, cu->x0, cu->y0);
             // TODO: Address performance issue here by combining transform, lmcs_scale_chroma, and add_residual into one function.
             // Complete this task before implementing ASM code.
-            fc->vvcdsp.itx.add_residual(dst, chroma_scale ? temp : tb->coeffs, w, h, stride);
+            fc->vvcdsp.itx.add_residual(dst, chroma_scale ? temp : coeffs, w, h, stride);
 
             if (tu->joint_cbcr_residual_flag && tb->c_idx)
-                add_residual_for_joint_coding_chroma(lc, tu, tb, chroma_scale);
+                add_residual_for_joint_coding_chroma(lc, tu, tb, coeffs, chroma_scale);
         }
     }
 }
@@ -488,7 +503,8 @@ static int reconstruct(VVCLocalContext *lc)
         TransformUnit *tu = cu->tus.head;
         for (int i = 0; tu; i++) {
             predict_intra(lc, tu, i, ch_type);
-            itransform(lc, tu, i, ch_type);
+            if (!fc->skip_idct)
+                itransform(lc, tu, i, ch_type);
             tu = tu->next;
         }
     }
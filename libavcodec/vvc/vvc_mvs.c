@@ -83,7 +83,7 @@ void ff_vvc_mv_scale(Mv *dst, const Mv *src, int td, int tb)
 }
 
 //part of 8.5.2.12 Derivation process for collocated motion vectors
-static int check_mvset(Mv *mvLXCol, Mv *mvCol,
+static int check_mvset(Mv *mvLXCol, const Mv *mvCol,
                        int colPic, int poc,
                        const RefPicList *refPicList, int X, int refIdxLx,
                        const RefPicList *refPicList_col, int listCol, int refidxCol)
@@ -101,7 +101,7 @@ static int check_mvset(Mv *mvLXCol, Mv *mvCol,
     col_poc_diff = colPic - refPicList_col[listCol].list[refidxCol];
     cur_poc_diff = poc    - refPicList[X].list[refIdxLx];
 
-    mv_compression(mvCol);
+    // mvCol is compressed already, see set_col_mvf()
     if (cur_lt || col_poc_diff == cur_poc_diff) {
         mvLXCol->x = av_clip_intp2(mvCol->x, 17);
         mvLXCol->y = av_clip_intp2(mvCol->y, 17);
@@ -136,7 +136,7 @@ int ff_vvc_no_backward_pred_flag(const VVCLocalContext *lc)
 }
 
 //8.5.2.12 Derivation process for collocated motion vectors
-static int derive_temporal_colocated_mvs(const VVCLocalContext *lc, MvField temp_col,
+static int derive_temporal_colocated_mvs(const VVCLocalContext *lc, const ColMvField temp_col,
                                          int refIdxLx, Mv *mvLXCol, int X,
                                          int colPic, const RefPicList *refPicList_col, int sb_flag)
 {
@@ -187,10 +187,30 @@ static int derive_temporal_colocated_mvs(const VVCLocalContext *lc, MvField temp
 #define TAB_MVF_PU(v)                                                   \
     TAB_MVF(x ## v, y ## v)
 
+#define TAB_COL_MVF(x, y)                                               \
+    tab_col_mvf[((y) >> 3) * col_width + ((x) >> 3)]
+
 #define TAB_CP_MV(lx, x, y)                                              \
     fc->tab.cp_mv[lx][((((y) >> min_cb_log2_size) * min_cb_width + ((x) >> min_cb_log2_size)) ) * MAX_CONTROL_POINTS]
 
 
+// rightBoundaryPos and botBoundaryPos of 8.5.2.11 and 8.5.5.4, plus one
+static void col_boundary(const VVCLocalContext *lc, int *right, int *bottom)
+{
+    const VVCFrameContext *fc = lc->fc;
+    const H266RawSPS *rsps    = fc->ps.sps->r;
+    const VVCPPS *pps         = fc->ps.pps;
+    const int idx             = lc->sc->sh.r->curr_subpic_idx;
+
+    if (rsps->sps_subpic_treated_as_pic_flag[idx]) {
+        *right  = pps->subpic_x[idx] + pps->subpic_width[idx];
+        *bottom = pps->subpic_y[idx] + pps->subpic_height[idx];
+    } else {
+        *right  = pps->width;
+        *bottom = pps->height;
+    }
+}
+
 #define DERIVE_TEMPORAL_COLOCATED_MVS(sb_flag)                          \
     derive_temporal_colocated_mvs(lc, temp_col,                          \
                                   refIdxLx, mvLXCol, X, colPic,         \
@@ -204,10 +224,11 @@ static int temporal_luma_motion_vector(const VVCLocalContext *lc,
     const VVCSPS *sps           = fc->ps.sps;
     const CodingUnit *cu        = lc->cu;
     int x, y, colPic, availableFlagLXCol = 0;
-    int min_pu_width = fc->ps.pps->min_pu_width;
+    int right, bottom;
+    const int col_width = fc->ps.pps->width8;
     VVCFrame *ref = fc->ref->collocated_ref;
-    MvField *tab_mvf;
-    MvField temp_col;
+    const ColMvField *tab_col_mvf;
+    ColMvField temp_col;
 
     if (!ref) {
         memset(mvLXCol, 0, sizeof(*mvLXCol));
@@ -217,30 +238,30 @@ static int temporal_luma_motion_vector(const VVCLocalContext *lc,
     if (!fc->ps.ph.r->ph_temporal_mvp_enabled_flag || (cu->cb_width * cu->cb_height <= 32))
         return 0;
 
-    tab_mvf = ref->tab_dmvr_mvf;
+    tab_col_mvf = ref->tab_col_mvf;
     colPic  = ref->poc;
 
     //bottom right collocated motion vector
     x = cu->x0 + cu->cb_width;
     y = cu->y0 + cu->cb_height;
+    col_boundary(lc, &right, &bottom);
 
-    if (tab_mvf &&
+    if (tab_col_mvf &&
         (cu->y0 >> sps->ctb_log2_size_y) == (y >> sps->ctb_log2_size_y) &&
-        y < fc->ps.sps->height &&
-        x < fc->ps.sps->width) {
+        y < bottom && x < right) {
         x                 &= ~7;
         y                 &= ~7;
-        temp_col           = TAB_MVF(x, y);
+        temp_col           = TAB_COL_MVF(x, y);
         availableFlagLXCol = DERIVE_TEMPORAL_COLOCATED_MVS(sb_flag);
     }
     if (check_center) {
         // derive center collocated motion vector
-        if (tab_mvf && !availableFlagLXCol) {
+        if (tab_col_mvf && !availableFlagLXCol) {
             x                  = cu->x0 + (cu->cb_width >> 1);
             y                  = cu->y0 + (cu->cb_height >> 1);
             x                 &= ~7;
             y                 &= ~7;
-            temp_col           = TAB_MVF(x, y);
+            temp_col           = TAB_COL_MVF(x, y);
             availableFlagLXCol = DERIVE_TEMPORAL_COLOCATED_MVS(sb_flag);
         }
     }
@@ -262,6 +283,56 @@ void ff_vvc_set_mvf(const VVCLocalContext *lc, const int x0, const int y0, const
     }
 }
 
+static av_always_inline void set_col_mvf(ColMvField *dst, const MvField *src)
+{
+    for (int i = 0; i < 2; i++) {
+        dst->mv[i] = src->mv[i];
+        mv_compression(dst->mv + i);
+        dst->ref_idx[i] = src->ref_idx[i];
+    }
+    dst->pred_flag = src->pred_flag;
+}
+
+// only the 8x8 blocks starting in the block take its motion
+void ff_vvc_store_col_mvf(const VVCFrameContext *fc, const int x0, const int y0, const int w, const int h)
+{
+    const MvField *tab_mvf      = fc->tab.mvf;
+    ColMvField *tab_col_mvf     = fc->ref->tab_col_mvf;
+    const int min_pu_width      = fc->ps.pps->min_pu_width;
+    const int col_width         = fc->ps.pps->width8;
+
+    for (int y = FFALIGN(y0, 8); y < y0 + h; y += 8) {
+        for (int x = FFALIGN(x0, 8); x < x0 + w; x += 8)
+            set_col_mvf(&TAB_COL_MVF(x, y), &TAB_MVF(x, y));
+    }
+}
+
+// blocks without stored motion read as intra to later pictures, PF_INTRA is 0
+void ff_vvc_clear_col_mvf(const VVCFrameContext *fc, ColMvField *tab_col_mvf,
+    const int x0, const int y0, const int w, const int h)
+{
+    const VVCPPS *pps           = fc->ps.pps;
+    const int col_width         = pps->width8;
+    const int w8                = AV_CEIL_RSHIFT(FFMIN(x0 + w, pps->width), 3) - (x0 >> 3);
+    const int y_end             = FFMIN(y0 + h, pps->height);
+
+    for (int y = y0; y < y_end; y += 8)
+        memset(&TAB_COL_MVF(x0, y), 0, w8 * sizeof(*tab_col_mvf));
+}
+
+void ff_vvc_set_col_mvf(const VVCFrameContext *fc, const int x0, const int y0, const int w, const int h, const MvField *mvf)
+{
+    ColMvField *tab_col_mvf     = fc->ref->tab_col_mvf;
+    const int col_width         = fc->ps.pps->width8;
+    ColMvField col;
+
+    set_col_mvf(&col, mvf);
+    for (int y = FFALIGN(y0, 8); y < y0 + h; y += 8) {
+        for (int x = FFALIGN(x0, 8); x < x0 + w; x += 8)
+            TAB_COL_MVF(x, y) = col;
+    }
+}
+
 void ff_vvc_set_intra_mvf(const VVCLocalContext *lc)
 {
     const VVCFrameContext *fc   = lc->fc;
@@ -993,33 +1064,35 @@ static av_always_inline int compare_pf_ref_idx(const MvField *A, const struct Mv
     return 1;
 }
 
-static av_always_inline void sb_clip_location(const VVCFrameContext *fc,
+static av_always_inline void sb_clip_location(const VVCLocalContext *lc,
     const int x_ctb, const int y_ctb, const Mv* temp_mv, int *x, int *y)
 {
-    const VVCPPS *pps       = fc->ps.pps;
-    const int ctb_log2_size = fc->ps.sps->ctb_log2_size_y;
-    *y = av_clip(*y + temp_mv->y, y_ctb, FFMIN(pps->height - 1, y_ctb + (1 << ctb_log2_size) - 1)) & ~7;
-    *x = av_clip(*x + temp_mv->x, x_ctb, FFMIN(pps->width - 1,  x_ctb + (1 << ctb_log2_size) + 3)) & ~7;
+    const int ctb_log2_size = lc->fc->ps.sps->ctb_log2_size_y;
+    int right, bottom;
+
+    col_boundary(lc, &right, &bottom);
+    *y = av_clip(*y + temp_mv->y, y_ctb, FFMIN(bottom - 1, y_ctb + (1 << ctb_log2_size) - 1)) & ~7;
+    *x = av_clip(*x + temp_mv->x, x_ctb, FFMIN(right - 1,  x_ctb + (1 << ctb_log2_size) + 3)) & ~7;
 }
 
 static void sb_temproal_luma_motion(const VVCLocalContext *lc,
     const int x_ctb, const int y_ctb, const Mv *temp_mv,
     int x, int y, uint8_t *pred_flag, Mv *mv)
 {
-    MvField temp_col;
+    ColMvField temp_col;
     Mv* mvLXCol;
     const int refIdxLx          = 0;
     const VVCFrameContext *fc   = lc->fc;
     const VVCSH *sh             = &lc->sc->sh;
-    const int min_pu_width      = fc->ps.pps->min_pu_width;
+    const int col_width         = fc->ps.pps->width8;
     VVCFrame *ref               = fc->ref->collocated_ref;
-    MvField *tab_mvf            = ref->tab_dmvr_mvf;
+    const ColMvField *tab_col_mvf = ref->tab_col_mvf;
     int colPic                  = ref->poc;
     int X                       = 0;
 
-    sb_clip_location(fc, x_ctb, y_ctb, temp_mv, &x, &y);
+    sb_clip_location(lc, x_ctb, y_ctb, temp_mv, &x, &y);
 
-    temp_col    = TAB_MVF(x, y);
+    temp_col    = TAB_COL_MVF(x, y);
     mvLXCol     = mv + 0;
     *pred_flag = DERIVE_TEMPORAL_COLOCATED_MVS(1);
     if (IS_B(sh->r)) {
@@ -42,5 +42,8 @@ int ff_vvc_no_backward_pred_flag(const VVCLocalContext *lc);
 MvField* ff_vvc_get_mvf(const VVCFrameContext *fc, const int x0, const int y0);
 void ff_vvc_set_mvf(const VVCLocalContext *lc, const int x0, const int y0, const int w, const int h, const MvField *mvf);
 void ff_vvc_set_intra_mvf(const VVCLocalContext *lc);
+void ff_vvc_store_col_mvf(const VVCFrameContext *fc, int x0, int y0, int w, int h);
+void ff_vvc_clear_col_mvf(const VVCFrameContext *fc, ColMvField *tab_col_mvf, int x0, int y0, int w, int h);
+void ff_vvc_set_col_mvf(const VVCFrameContext *fc, int x0, int y0, int w, int h, const MvField *mvf);
 
 #endif //AVCODEC_VVC_VVC_MVS_H
@@ -270,6 +270,8 @@ static void pps_width_height(VVCPPS *pps, const VVCSPS *sps)
     pps->min_tu_width   = pps->width  >> MIN_TU_LOG2;
     pps->min_tu_height  = pps->height >> MIN_TU_LOG2;
 
+    pps->width8         = AV_CEIL_RSHIFT(pps->width,  3);
+    pps->height8        = AV_CEIL_RSHIFT(pps->height, 3);
     pps->width32        = AV_CEIL_RSHIFT(pps->width,  5);
     pps->height32       = AV_CEIL_RSHIFT(pps->height, 5);
     pps->width64        = AV_CEIL_RSHIFT(pps->width,  6);
@@ -433,6 +435,43 @@ static void pps_ref_wraparound_offset(VVCPPS *pps, const VVCSPS *sps)
         pps->ref_wraparound_offset = (pps->width / sps->min_cb_size_y) - r->pps_pic_width_minus_wraparound_offset;
 }
 
+static int pps_subpic(VVCPPS *pps, const VVCSPS *sps)
+{
+    const H266RawSPS *rsps = sps->r;
+
+    pps->ctb_to_subpic = av_calloc(pps->ctb_count, sizeof(*pps->ctb_to_subpic));
+    if (!pps->ctb_to_subpic)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i <= rsps->sps_num_subpics_minus1; i++) {
+        if (rsps->sps_num_subpics_minus1) {
+            const int log2_ctb = sps->ctb_log2_size_y;
+            const int x        = rsps->sps_subpic_ctu_top_left_x[i] << log2_ctb;
+            const int y        = rsps->sps_subpic_ctu_top_left_y[i] << log2_ctb;
+
+            // the motion compensation is clipped to these
+            if (x >= pps->width || y >= pps->height)
+                return AVERROR_INVALIDDATA;
+            pps->subpic_x[i]      = x;
+            pps->subpic_y[i]      = y;
+            pps->subpic_width[i]  = FFMIN(pps->width  - x, (rsps->sps_subpic_width_minus1[i]  + 1) << log2_ctb);
+            pps->subpic_height[i] = FFMIN(pps->height - y, (rsps->sps_subpic_height_minus1[i] + 1) << log2_ctb);
+
+            for (int ry = y >> log2_ctb; ry < AV_CEIL_RSHIFT(y + pps->subpic_height[i], log2_ctb); ry++) {
+                for (int rx = x >> log2_ctb; rx < AV_CEIL_RSHIFT(x + pps->subpic_width[i], log2_ctb); rx++)
+                    pps->ctb_to_subpic[ry * pps->ctb_width + rx] = i;
+            }
+        } else {
+            pps->subpic_x[i]      = 0;
+            pps->subpic_y[i]      = 0;
+            pps->subpic_width[i]  = pps->width;
+            pps->subpic_height[i] = pps->height;
+        }
+    }
+
+    return 0;
+}
+
 static int pps_derive(VVCPPS *pps, const VVCSPS *sps)
 {
     int ret;
@@ -450,6 +489,10 @@ static int pps_derive(VVCPPS *pps, const VVCSPS *sps)
 
     pps_ref_wraparound_offset(pps, sps);
 
+    ret = pps_subpic(pps, sps);
+    if (ret < 0)
+        return ret;
+
     return 0;
 }
 
@@ -464,6 +507,7 @@ static void pps_free(FFRefStructOpaque opaque, void *obj)
     av_freep(&pps->ctb_to_col_bd);
     av_freep(&pps->ctb_to_row_bd);
     av_freep(&pps->ctb_addr_in_slice);
+    av_freep(&pps->ctb_to_subpic);
 }
 
 static const VVCPPS *pps_alloc(const H266RawPPS *rpps, const VVCSPS *sps)
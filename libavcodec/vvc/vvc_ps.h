@@ -122,6 +122,8 @@ typedef struct VVCPPS {
     uint16_t *ctb_to_col_bd;
     uint16_t *ctb_to_row_bd;
 
+    uint16_t width8;                        ///< width  in 8 pixels
+    uint16_t height8;                       ///< height in 8 pixels
     uint16_t width32;                       ///< width  in 32 pixels
     uint16_t height32;                      ///< height in 32 pixels
     uint16_t width64;                       ///< width  in 64 pixels
@@ -129,6 +131,12 @@ typedef struct VVCPPS {
 
     uint16_t ref_wraparound_offset;         ///< PpsRefWraparoundOffset
 
+    uint16_t subpic_x[VVC_MAX_SLICES];      ///< SubpicLeftBoundaryPos
+    uint16_t subpic_y[VVC_MAX_SLICES];      ///< SubpicTopBoundaryPos
+    uint16_t subpic_width[VVC_MAX_SLICES];  ///< SubpicRightBoundaryPos - SubpicLeftBoundaryPos + 1
+    uint16_t subpic_height[VVC_MAX_SLICES]; ///< SubpicBotBoundaryPos - SubpicTopBoundaryPos + 1
+    uint16_t *ctb_to_subpic;                ///< subpicture index of each CTB in raster scan
+
 } VVCPPS;
 
 #define MAX_WEIGHTS 15
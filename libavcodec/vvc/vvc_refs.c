@@ -22,24 +22,25 @@
 
 #include <stdatomic.h>
 
-#include "libavutil/thread.h"
 #include "libavcodec/refstruct.h"
 #include "libavcodec/thread.h"
 
+#include "vvc_ctu.h"
+#include "vvc_mvs.h"
 #include "vvc_refs.h"
 
-#define VVC_FRAME_FLAG_OUTPUT    (1 << 0)
-#define VVC_FRAME_FLAG_SHORT_REF (1 << 1)
-#define VVC_FRAME_FLAG_LONG_REF  (1 << 2)
-#define VVC_FRAME_FLAG_BUMPING   (1 << 3)
+/*
+ * Listeners are bucketed by the CTU row they wait for. Each bucket is a
+ * lock-free stack, closed by swapping in LISTENERS_CLOSED once its row
+ * is done. A listener that finds its bucket closed fires immediately.
+ */
+#define LISTENERS_CLOSED ((uintptr_t)1)
 
 typedef struct FrameProgress {
     atomic_int progress[VVC_PROGRESS_LAST];
-    VVCProgressListener *listener[VVC_PROGRESS_LAST];
-    AVMutex lock;
-    AVCond  cond;
-    uint8_t has_lock;
-    uint8_t has_cond;
+    atomic_uintptr_t *listener[VVC_PROGRESS_LAST];   ///< nb_rows buckets each
+    int nb_rows;
+    int row_log2;
 } FrameProgress;
 
 void ff_vvc_unref_frame(VVCFrameContext *fc, VVCFrame *frame, int flags)
@@ -53,7 +54,7 @@ void ff_vvc_unref_frame(VVCFrameContext *fc, VVCFrame *frame, int flags)
         av_frame_unref(frame->frame);
         ff_refstruct_unref(&frame->progress);
 
-        ff_refstruct_unref(&frame->tab_dmvr_mvf);
+        ff_refstruct_unref(&frame->tab_col_mvf);
 
         ff_refstruct_unref(&frame->rpl);
         frame->nb_rpl_elems = 0;
@@ -86,31 +87,84 @@ void ff_vvc_flush_dpb(VVCFrameContext *fc)
         ff_vvc_unref_frame(fc, &fc->DPB[i], ~0);
 }
 
-static void free_progress(FFRefStructOpaque unused, void *obj)
+void ff_vvc_pad_ctu(const VVCFrameContext *fc, AVFrame *frame, const int rx, const int ry)
 {
-    FrameProgress *p = (FrameProgress *)obj;
+    const VVCSPS *sps = fc->ps.sps;
+    const VVCPPS *pps = fc->ps.pps;
+    const int ps      = sps->pixel_shift;
+    const int c_end   = sps->r->sps_chroma_format_idc ? VVC_MAX_SAMPLE_ARRAYS : 1;
+
+    for (int c_idx = 0; c_idx < c_end; c_idx++) {
+        const int hs            = sps->hshift[c_idx];
+        const int vs            = sps->vshift[c_idx];
+        const int pad_x         = fc->ref_padding >> hs;
+        const int pad_y         = fc->ref_padding >> vs;
+        const int width         = pps->width  >> hs;
+        const int height        = pps->height >> vs;
+        const int x0            = (rx << sps->ctb_log2_size_y) >> hs;
+        const int y0            = (ry << sps->ctb_log2_size_y) >> vs;
+        const int x_end         = FFMIN(x0 + (sps->ctb_size_y >> hs), width);
+        const int y_end         = FFMIN(y0 + (sps->ctb_size_y >> vs), height);
+        const ptrdiff_t stride  = frame->linesize[c_idx];
+        uint8_t *data           = frame->data[c_idx];
+        int left                = x0    << ps;
+        int right               = x_end << ps;
+
+        // the top and bottom bands take the corners along
+        if (!x0) {
+            for (int y = y0; y < y_end; y++) {
+                uint8_t *dst = data + y * stride - (pad_x << ps);
+                memcpy(dst, dst + (pad_x << ps), 1 << ps);
+                av_memcpy_backptr(dst + (1 << ps), 1 << ps, (pad_x - 1) << ps);
+            }
+            left -= pad_x << ps;
+        }
+        if (x_end == width) {
+            for (int y = y0; y < y_end; y++)
+                av_memcpy_backptr(data + y * stride + right, 1 << ps, pad_x << ps);
+            right += pad_x << ps;
+        }
+        if (!y0) {
+            for (int y = 1; y <= pad_y; y++)
+                memcpy(data - y * stride + left, data + left, right - left);
+        }
+        if (y_end == height) {
+            const uint8_t *src = data + (height - 1) * stride + left;
+            for (int y = height; y < height + pad_y; y++)
+                memcpy(data + y * stride + left, src, right - left);
+        }
+    }
+}
 
-    if (p->has_cond)
-        ff_cond_destroy(&p->cond);
-    if (p->has_lock)
-        ff_mutex_destroy(&p->lock);
+FFRefStructPool *ff_vvc_progress_pool_alloc(const int nb_rows)
+{
+    return ff_refstruct_pool_alloc(sizeof(FrameProgress) +
+        VVC_PROGRESS_LAST * nb_rows * sizeof(atomic_uintptr_t), FF_REFSTRUCT_POOL_FLAG_NO_ZEROING);
 }
 
-static FrameProgress *alloc_progress(void)
+// pooled objects are recycled once all references are gone, so no one can still be listening
+static FrameProgress *alloc_progress(FFRefStructPool *pool, const int nb_rows, const int row_log2)
 {
-    FrameProgress *p = ff_refstruct_alloc_ext(sizeof(*p), 0, NULL, free_progress);
+    FrameProgress *p = ff_refstruct_pool_get(pool);
 
     if (p) {
-        p->has_lock = !ff_mutex_init(&p->lock, NULL);
-        p->has_cond = !ff_cond_init(&p->cond, NULL);
-        if (!p->has_lock || !p->has_cond)
-            ff_refstruct_unref(&p);
+        atomic_uintptr_t *buckets = (atomic_uintptr_t *)(p + 1);
+
+        p->nb_rows  = nb_rows;
+        p->row_log2 = row_log2;
+        for (int vp = 0; vp < VVC_PROGRESS_LAST; vp++) {
+            atomic_init(&p->progress[vp], 0);
+            p->listener[vp] = buckets + vp * nb_rows;
+            for (int i = 0; i < nb_rows; i++)
+                atomic_init(&p->listener[vp][i], 0);
+        }
     }
     return p;
 }
 
 static VVCFrame *alloc_frame(VVCContext *s, VVCFrameContext *fc)
 {
+    const VVCSPS *sps = fc->ps.sps;
     const VVCPPS *pps = fc->ps.pps;
     for (int i = 0; i < FF_ARRAY_ELEMS(fc->DPB); i++) {
         int ret;
@@ -118,17 +172,32 @@ static VVCFrame *alloc_frame(VVCContext *s, VVCFrameContext *fc)
         if (frame->frame->buf[0])
             continue;
 
+        if (fc->ref_padding) {
+            frame->frame->width  = pps->width  + 2 * fc->ref_padding;
+            frame->frame->height = pps->height + 2 * fc->ref_padding;
+        }
+
         ret = ff_thread_get_buffer(s->avctx, frame->frame, AV_GET_BUFFER_FLAG_REF);
         if (ret < 0)
             return NULL;
 
-        frame->rpl = ff_refstruct_allocz(s->current_frame.nb_units * sizeof(RefPicListTab));
+        if (fc->ref_padding) {
+            for (int c = 0; frame->frame->data[c]; c++) {
+                const int pad_x = fc->ref_padding >> sps->hshift[c];
+                const int pad_y = fc->ref_padding >> sps->vshift[c];
+                frame->frame->data[c] += pad_y * frame->frame->linesize[c] + (pad_x << sps->pixel_shift);
+            }
+            frame->frame->width  = pps->width;
+            frame->frame->height = pps->height;
+        }
+
+        frame->rpl = ff_refstruct_pool_get(fc->rpl_pool);
         if (!frame->rpl)
             goto fail;
-        frame->nb_rpl_elems = s->current_frame.nb_units;
+        frame->nb_rpl_elems = fc->tab.sz.nb_rpl_elems;
 
-        frame->tab_dmvr_mvf = ff_refstruct_pool_get(fc->tab_dmvr_mvf_pool);
-        if (!frame->tab_dmvr_mvf)
+        frame->tab_col_mvf = ff_refstruct_pool_get(fc->tab_col_mvf_pool);
+        if (!frame->tab_col_mvf)
             goto fail;
 
         frame->rpl_tab = ff_refstruct_pool_get(fc->rpl_tab_pool);
@@ -138,7 +207,7 @@ static VVCFrame *alloc_frame(VVCContext *s, VVCFrameContext *fc)
         for (int j = 0; j < frame->ctb_count; j++)
             frame->rpl_tab[j] = frame->rpl;
 
-        frame->progress = alloc_progress();
+        frame->progress = alloc_progress(fc->progress_pool, pps->ctb_height, sps->ctb_log2_size_y);
         if (!frame->progress)
             goto fail;
 
@@ -197,6 +266,7 @@ int ff_vvc_output_frame(VVCContext *s, VVCFrameContext *fc, AVFrame *out, const
 {
     const VVCSPS *sps = fc->ps.sps;
     do {
+        const H266DpbParameters *dpb = sps ? &sps->r->sps_dpb_params : NULL;
         int nb_output = 0;
         int min_poc   = INT_MAX;
         int min_idx, ret;
@@ -223,9 +293,11 @@ int ff_vvc_output_frame(VVCContext *s, VVCFrameContext *fc, AVFrame *out, const
             }
         }
 
-        /* wait for more frames before output */
+        /* wait for more frames before output, sliding_output bumps as soon as C.5.2.2 allows it */
         if (!flush && s->seq_output == s->seq_decode && sps &&
-            nb_output <= sps->r->sps_dpb_params.dpb_max_dec_pic_buffering_minus1[sps->r->sps_max_sublayers_minus1] + 1)
+            nb_output <= (s->sliding_output ?
+                dpb->dpb_max_num_reorder_pics[sps->r->sps_max_sublayers_minus1] :
+                dpb->dpb_max_dec_pic_buffering_minus1[sps->r->sps_max_sublayers_minus1] + 1))
             return 0;
 
         if (nb_output) {
@@ -334,9 +406,17 @@ static VVCFrame *generate_missing_ref(VVCContext *s, VVCFrameContext *fc, int po
                     AV_WN16(dst, 1 << (sps->bit_depth - 1));
                     av_memcpy_backptr(dst + 2, 2, 2*(sps->width >> sps->hshift[i]) - 2);
                 }
+            if (fc->ref_padding) {
+                for (int ry = 0; ry < fc->ps.pps->ctb_height; ry++)
+                    for (int rx = 0; rx < fc->ps.pps->ctb_width; rx++)
+                        ff_vvc_pad_ctu(fc, frame->frame, rx, ry);
+            }
         }
     }
 
+    // never parsed, so nothing else clears the pooled motion field
+    ff_vvc_clear_col_mvf(fc, frame->tab_col_mvf, 0, 0, fc->ps.pps->width, fc->ps.pps->height);
+
     frame->poc      = poc;
     frame->sequence = s->seq_decode;
     frame->flags    = 0;
@@ -497,69 +577,64 @@ void ff_vvc_report_frame_finished(VVCFrame *frame)
 
 static int is_progress_done(const FrameProgress *p, const VVCProgressListener *l)
 {
-    return p->progress[l->vp] > l->y;
+    return atomic_load(&p->progress[l->vp]) > l->y;
 }
 
-static void add_listener(VVCProgressListener **prev, VVCProgressListener *l)
+// listeners in bucket n wait for a y in [n, n + 1) rows, the last one also takes everything below the picture
+static int listener_bucket(const FrameProgress *p, const int y)
 {
-    l->next = *prev;
-    *prev   = l;
+    return FFMIN(y >> p->row_log2, p->nb_rows - 1);
 }
 
-static VVCProgressListener* remove_listener(VVCProgressListener **prev, VVCProgressListener *l)
+// number of buckets whose listeners are all done at progress y
+static int done_buckets(const FrameProgress *p, const int y)
 {
-    *prev  = l->next;
-    l->next = NULL;
-    return l;
+    return y == INT_MAX ? p->nb_rows : FFMIN(y >> p->row_log2, p->nb_rows);
 }
 
-static VVCProgressListener* get_done_listener(FrameProgress *p, const VVCProgress vp)
+static void close_bucket(atomic_uintptr_t *bucket)
 {
-    VVCProgressListener *list = NULL;
-    VVCProgressListener **prev = &p->listener[vp];
+    const uintptr_t head = atomic_exchange(bucket, LISTENERS_CLOSED);
+    VVCProgressListener *l;
 
-    while (*prev) {
-        if (is_progress_done(p, *prev)) {
-            VVCProgressListener *l = remove_listener(prev, *prev);
-            add_listener(&list, l);
-        } else {
-            prev = &(*prev)->next;
-        }
+    if (head == LISTENERS_CLOSED)
+        return;
+
+    l = (VVCProgressListener *)head;
+    while (l) {
+        VVCProgressListener *next = l->next;
+        l->next = NULL;
+        l->progress_done(l);
+        l = next;
     }
-    return list;
 }
 
+/*
+ * Progress is reported in whole CTU rows, or INT_MAX once the frame is
+ * finished, so only the buckets of the newly completed rows are touched.
+ */
 void ff_vvc_report_progress(VVCFrame *frame, const VVCProgress vp, const int y)
 {
     FrameProgress *p = frame->progress;
-    VVCProgressListener *l = NULL;
-
-    ff_mutex_lock(&p->lock);
-
-    av_assert0(p->progress[vp] < y || p->progress[vp] == INT_MAX);
-    p->progress[vp] = y;
-    l = get_done_listener(p, vp);
-    ff_cond_signal(&p->cond);
+    const int old    = atomic_exchange(&p->progress[vp], y);
+    const int end    = done_buckets(p, y);
 
-    ff_mutex_unlock(&p->lock);
-
-    while (l) {
-        l->progress_done(l);
-        l = l->next;
-    }
+    av_assert0(old < y || old == INT_MAX);
+    for (int i = done_buckets(p, old); i < end; i++)
+        close_bucket(p->listener[vp] + i);
 }
 
 void ff_vvc_add_progress_listener(VVCFrame *frame, VVCProgressListener *l)
 {
-    FrameProgress *p = frame->progress;
+    FrameProgress *p         = frame->progress;
+    atomic_uintptr_t *bucket = p->listener[l->vp] + listener_bucket(p, l->y);
+    uintptr_t head           = atomic_load(bucket);
 
-    ff_mutex_lock(&p->lock);
-
-    if (is_progress_done(p, l)) {
-        ff_mutex_unlock(&p->lock);
-        l->progress_done(l);
-    } else {
-        add_listener(p->listener + l->vp, l);
-        ff_mutex_unlock(&p->lock);
-    }
+    do {
+        if (head == LISTENERS_CLOSED || is_progress_done(p, l)) {
+            l->progress_done(l);
+            return;
+        }
+        l->next = (VVCProgressListener *)head;
+    } while (!atomic_compare_exchange_weak(bucket, &head, (uintptr_t)l));
 }
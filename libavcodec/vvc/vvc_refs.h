@@ -25,6 +25,11 @@
 
 #include "vvcdec.h"
 
+#define VVC_FRAME_FLAG_OUTPUT    (1 << 0)
+#define VVC_FRAME_FLAG_SHORT_REF (1 << 1)
+#define VVC_FRAME_FLAG_LONG_REF  (1 << 2)
+#define VVC_FRAME_FLAG_BUMPING   (1 << 3)
+
 int ff_vvc_output_frame(VVCContext *s, VVCFrameContext *fc, struct AVFrame *out, int no_output_of_prior_pics_flag, int flush);
 void ff_vvc_bump_frame(VVCContext *s, VVCFrameContext *fc);
 int ff_vvc_set_new_ref(VVCContext *s, VVCFrameContext *fc, struct AVFrame **frame);
@@ -35,6 +40,17 @@ void ff_vvc_unref_frame(VVCFrameContext *fc, VVCFrame *frame, int flags);
 void ff_vvc_clear_refs(VVCFrameContext *fc);
 void ff_vvc_flush_dpb(VVCFrameContext *fc);
 
+/**
+ * Allocate a pool of frame progress objects for pictures nb_rows CTUs high.
+ */
+struct FFRefStructPool *ff_vvc_progress_pool_alloc(int nb_rows);
+
+/**
+ * Replicate the border pixels of the CTU at (rx, ry) into the guard band of frame
+ * if the CTU lies on the picture edge. Needs fc->ref_padding.
+ */
+void ff_vvc_pad_ctu(const VVCFrameContext *fc, struct AVFrame *frame, int rx, int ry);
+
 typedef enum VVCProgress {
     VVC_PROGRESS_MV,
     VVC_PROGRESS_PIXEL,
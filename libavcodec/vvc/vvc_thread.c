@@ -23,7 +23,11 @@
 #include <stdatomic.h>
 
 #include "libavutil/executor.h"
+#include "libavutil/intmath.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/avcodec.h"
 
 #include "vvc_thread.h"
 #include "vvc_ctu.h"
@@ -36,6 +40,7 @@ typedef struct ProgressListener {
     VVCProgressListener l;
     struct VVCTask *task;
     VVCContext *s;
+    int64_t start;                  //when the listener was added, with task_stats only
 } ProgressListener;
 
 typedef enum VVCTaskStage {
@@ -51,10 +56,7 @@ typedef enum VVCTaskStage {
 } VVCTaskStage;
 
 typedef struct VVCTask {
-    union {
-        struct VVCTask *next;                //for executor debug only
-        AVTask task;
-    } u;
+    struct VVCTask *next;           //ready queue link, protected by VVCScheduler.lock
 
     VVCTaskStage stage;
 
@@ -73,16 +75,29 @@ typedef struct VVCTask {
     // tasks with target scores met are ready for scheduling
     atomic_uchar score[VVC_TASK_STAGE_LAST];
     atomic_uchar target_inter_score;
+
+    int64_t ready_time;             //when the task was queued, with task_stats only
 } VVCTask;
 
 typedef struct VVCRowThread {
     atomic_int col_progress[VVC_PROGRESS_LAST];
 } VVCRowThread;
 
+typedef struct VVCTaskQueue {
+    VVCTask *head;
+    VVCTask *tail;
+} VVCTaskQueue;
+
 typedef struct VVCFrameThread {
     // error return for tasks
     atomic_int ret;
 
+    VVCContext *s;
+
+    // ready tasks, one queue per stage, protected by VVCScheduler.lock
+    VVCTaskQueue ready[VVC_TASK_STAGE_LAST];
+    unsigned ready_mask;            //bit n set if ready[pop_order[n]] is not empty
+
     VVCRowThread *rows;
     VVCTask *tasks;
 
@@ -91,6 +106,9 @@ typedef struct VVCFrameThread {
     int ctu_height;
     int ctu_count;
 
+    int row_tasks;                  //run a newly ready right neighbour inline, see VVC_TASK_GRANULARITY_ROW
+    int draw_bands;                 //call draw_horiz_band, see use_draw_horiz_band()
+
     //protected by lock
     atomic_int nb_scheduled_tasks;
     atomic_int nb_scheduled_listeners;
@@ -101,13 +119,238 @@ typedef struct VVCFrameThread {
     AVCond  cond;
 } VVCFrameThread;
 
-static void add_task(VVCContext *s, VVCTask *t)
+/*
+ * Ready tasks are not handed to the executor directly. They are queued per
+ * (frame, stage) and the executor runs interchangeable runners, each of
+ * them popping the best ready task in O(1). At most one runner per worker
+ * thread is queued in the executor, so it never has to sort or poll the
+ * tasks themselves.
+ */
+typedef struct VVCTaskRunner {
+    AVTask task;
+    struct VVCScheduler *sched;
+    struct VVCTaskRunner *next;     //idle list link
+} VVCTaskRunner;
+
+/*
+ * Opt-in counters for profiling the pipeline, all times are in microseconds.
+ * They are updated from any thread, hence the atomics.
+ */
+typedef struct VVCStageStats {
+    atomic_int_least64_t nb_tasks;
+    atomic_int_least64_t run_time;
+    atomic_int_least64_t ready_time;        //queued but not yet picked up by a runner
+    atomic_int_least64_t wait_time;         //waiting for the progress of a reference frame
+} VVCStageStats;
+
+typedef struct VVCTaskStats {
+    VVCStageStats stages[VVC_TASK_STAGE_LAST];
+    atomic_int_least64_t nb_locks;
+    atomic_int_least64_t lock_time;         //waiting for VVCScheduler.lock
+} VVCTaskStats;
+
+typedef struct VVCScheduler {
+    VVCContext *s;
+
+    AVMutex lock;
+    AVCond  cond;
+
+    // frames with ready tasks, in decode order
+    VVCFrameContext **frames;
+    int nb_frames;
+    int max_frames;
+
+    VVCTaskRunner *runners;
+    int nb_runners;
+    VVCTaskRunner *idle;            //runners not queued in the executor
+    int nb_idle;
+
+    VVCTaskStats *stats;            //NULL unless the task_stats option is set
+
+    // idle time of the runners while the caller waits for a frame, see ff_vvc_executor_starved()
+    int sample_idle;                //the frame window may still grow
+    int64_t idle_time;              //integral of nb_idle over time
+    int64_t idle_stamp;             //time idle_time was last brought up to
+    int64_t wait_idle_time;         //part of idle_time spent in ff_vvc_frame_wait()
+    int64_t sample_start;           //start of the current sample
+
+    // job of the decoding thread, see ff_vvc_job_submit()
+    int (*job)(VVCContext *s);      //not yet picked up by a runner
+    int job_pending;                //submitted and not finished
+    int job_ret;
+} VVCScheduler;
+
+/*
+ * Order in which the stages of one frame are served. Parsing comes first since
+ * everything else depends on it. A single reference row may release a whole row
+ * of inter tasks at once, so they come last to keep them from crowding out the
+ * stages that finish the frame.
+ */
+static const VVCTaskStage pop_order[] = {
+    VVC_TASK_STAGE_PARSE,
+    VVC_TASK_STAGE_RECON,
+    VVC_TASK_STAGE_LMCS,
+    VVC_TASK_STAGE_DEBLOCK_V,
+    VVC_TASK_STAGE_DEBLOCK_H,
+    VVC_TASK_STAGE_SAO,
+    VVC_TASK_STAGE_ALF,
+    VVC_TASK_STAGE_INTER,
+};
+
+static int stage_to_bit(const VVCTaskStage stage)
+{
+    static const uint8_t bits[] = {
+        0,      //VVC_TASK_STAGE_PARSE
+        7,      //VVC_TASK_STAGE_INTER
+        1,      //VVC_TASK_STAGE_RECON
+        2,      //VVC_TASK_STAGE_LMCS
+        3,      //VVC_TASK_STAGE_DEBLOCK_V
+        4,      //VVC_TASK_STAGE_DEBLOCK_H
+        5,      //VVC_TASK_STAGE_SAO
+        6,      //VVC_TASK_STAGE_ALF
+    };
+    return bits[stage];
+}
+
+static void stats_add(atomic_int_least64_t *counter, const int64_t v)
+{
+    atomic_fetch_add_explicit(counter, v, memory_order_relaxed);
+}
+
+static void scheduler_lock(VVCScheduler *sched)
+{
+    VVCTaskStats *stats = sched->stats;
+    int64_t start;
+
+    if (!stats) {
+        ff_mutex_lock(&sched->lock);
+        return;
+    }
+
+    start = av_gettime_relative();
+    ff_mutex_lock(&sched->lock);
+    stats_add(&stats->lock_time, av_gettime_relative() - start);
+    stats_add(&stats->nb_locks, 1);
+}
+
+static void scheduler_add_frame(VVCScheduler *sched, VVCFrameContext *fc)
+{
+    int i = sched->nb_frames;
+
+    av_assert0(sched->nb_frames < sched->max_frames);
+    while (i > 0 && sched->frames[i - 1]->decode_order > fc->decode_order) {
+        sched->frames[i] = sched->frames[i - 1];
+        i--;
+    }
+    sched->frames[i] = fc;
+    sched->nb_frames++;
+}
+
+static void scheduler_remove_frame(VVCScheduler *sched, const int idx)
+{
+    sched->nb_frames--;
+    memmove(sched->frames + idx, sched->frames + idx + 1, (sched->nb_frames - idx) * sizeof(*sched->frames));
+}
+
+static void scheduler_push(VVCScheduler *sched, VVCTask *t)
 {
     VVCFrameThread *ft = t->fc->ft;
+    const int bit      = stage_to_bit(t->stage);
+    VVCTaskQueue *q    = ft->ready + t->stage;
+
+    if (!ft->ready_mask)
+        scheduler_add_frame(sched, t->fc);
+    ft->ready_mask |= 1 << bit;
+
+    if (sched->stats)
+        t->ready_time = av_gettime_relative();
+
+    t->next = NULL;
+    if (q->tail)
+        q->tail->next = t;
+    else
+        q->head = t;
+    q->tail = t;
+}
+
+static VVCTask* scheduler_pop(VVCScheduler *sched)
+{
+    VVCFrameThread *ft;
+    VVCTaskQueue *q;
+    VVCTask *t;
+    int bit;
+
+    if (!sched->nb_frames)
+        return NULL;
+
+    ft  = sched->frames[0]->ft;
+    bit = ff_ctz(ft->ready_mask);
+    q   = ft->ready + pop_order[bit];
+    t   = q->head;
+
+    q->head = t->next;
+    t->next = NULL;
+    if (!q->head) {
+        q->tail = NULL;
+        ft->ready_mask &= ~(1 << bit);
+        if (!ft->ready_mask)
+            scheduler_remove_frame(sched, 0);
+    }
+
+    if (sched->stats)
+        stats_add(&sched->stats->stages[t->stage].ready_time, av_gettime_relative() - t->ready_time);
+
+    return t;
+}
+
+// bring idle_time up to now, before any change of nb_idle
+static int64_t scheduler_update_idle_time(VVCScheduler *sched)
+{
+    if (sched->sample_idle) {
+        const int64_t now = av_gettime_relative();
+        sched->idle_time += sched->nb_idle * (now - sched->idle_stamp);
+        sched->idle_stamp = now;
+    }
+    return sched->idle_time;
+}
+
+static VVCTaskRunner* scheduler_get_idle_runner(VVCScheduler *sched)
+{
+    VVCTaskRunner *r = sched->idle;
+
+    if (r) {
+        scheduler_update_idle_time(sched);
+        sched->idle = r->next;
+        r->next     = NULL;
+        sched->nb_idle--;
+    }
+    return r;
+}
+
+static void scheduler_park_runner(VVCScheduler *sched, VVCTaskRunner *r)
+{
+    scheduler_update_idle_time(sched);
+    r->next     = sched->idle;
+    sched->idle = r;
+    if (++sched->nb_idle == sched->nb_runners)
+        ff_cond_signal(&sched->cond);
+}
+
+static void add_task(VVCContext *s, VVCTask *t)
+{
+    VVCFrameThread *ft    = t->fc->ft;
+    VVCScheduler *sched   = s->scheduler;
+    VVCTaskRunner *runner;
 
     atomic_fetch_add(&ft->nb_scheduled_tasks, 1);
 
-    av_executor_execute(s->executor, &t->u.task);
+    scheduler_lock(sched);
+    scheduler_push(sched, t);
+    runner = scheduler_get_idle_runner(sched);
+    ff_mutex_unlock(&sched->lock);
+
+    if (runner)
+        av_executor_execute(s->executor, &runner->task);
 }
 
 static void task_init(VVCTask *t, VVCTaskStage stage, VVCFrameContext *fc, const int rx, const int ry)
@@ -183,19 +426,31 @@ static int task_has_target_score(VVCTask *t, const VVCTaskStage stage, const uin
     return score == target + 1;
 }
 
-static void frame_thread_add_score(VVCContext *s, VVCFrameThread *ft,
+// returns the task if this score made it ready, the caller must run it
+static VVCTask* frame_thread_claim_score(VVCFrameThread *ft,
     const int rx, const int ry, const VVCTaskStage stage)
 {
     VVCTask *t = ft->tasks + ft->ctu_width * ry + rx;
     uint8_t score;
 
     if (rx < 0 || rx >= ft->ctu_width || ry < 0 || ry >= ft->ctu_height)
-        return;
+        return NULL;
 
     score = task_add_score(t, stage);
-    if (task_has_target_score(t, stage, score)) {
+    if (!task_has_target_score(t, stage, score))
+        return NULL;
+
+    av_assert0(stage == t->stage);
+    return t;
+}
+
+static void frame_thread_add_score(VVCContext *s, VVCFrameThread *ft,
+    const int rx, const int ry, const VVCTaskStage stage)
+{
+    VVCTask *t = frame_thread_claim_score(ft, rx, ry, stage);
+
+    if (t) {
         av_assert0(s);
-        av_assert0(stage == t->stage);
         add_task(s, t);
     }
 }
@@ -214,6 +469,10 @@ static void progress_done(VVCProgressListener *_l, const int type)
     const ProgressListener *l = (ProgressListener *)_l;
     const VVCTask *t          = l->task;
     VVCFrameThread *ft        = t->fc->ft;
+    VVCTaskStats *stats       = l->s->scheduler->stats;
+
+    if (stats)
+        stats_add(&stats->stages[type].wait_time, av_gettime_relative() - l->start);
 
     frame_thread_add_score(l->s, ft, t->rx, t->ry, type);
     sheduled_done(ft, &ft->nb_scheduled_listeners);
@@ -235,6 +494,7 @@ static void listener_init(ProgressListener *l,  VVCTask *t, VVCContext *s, const
 
     l->task = t;
     l->s    = s;
+    l->start = s->scheduler->stats ? av_gettime_relative() : 0;
     l->l.vp = vp;
     l->l.y  = y;
     l->l.progress_done = is_inter ? pixel_done : mv_done;
@@ -307,25 +567,37 @@ static void parse_task_done(VVCContext *s, VVCFrameContext *fc, const int rx, co
     schedule_inter(s, fc, sc, t, rs);
 }
 
-static void task_stage_done(const VVCTask *t, VVCContext *s)
+/*
+ * Returns the right neighbour if it became ready for the same stage and
+ * ft->row_tasks is set, it is not queued then and the caller must run it.
+ */
+static VVCTask* task_stage_done(const VVCTask *t, VVCContext *s)
 {
     VVCFrameContext *fc      = t->fc;
     VVCFrameThread *ft       = fc->ft;
     const VVCTaskStage stage = t->stage;
+    VVCTask *next            = NULL;
 
 #define ADD(dx, dy, stage) frame_thread_add_score(s, ft, t->rx + (dx), t->ry + (dy), stage)
+#define ADD_RIGHT(stage)                                                        \
+    do {                                                                        \
+        if (s && ft->row_tasks)                                                 \
+            next = frame_thread_claim_score(ft, t->rx + 1, t->ry, stage);       \
+        else                                                                    \
+            ADD(1, 0, stage);                                                   \
+    } while (0)
 
     //this is a reserve map of ready_score, ordered by zigzag
     if (stage == VVC_TASK_STAGE_PARSE) {
         parse_task_done(s, fc, t->rx, t->ry);
     } else if (stage == VVC_TASK_STAGE_RECON) {
         ADD(-1,  1, VVC_TASK_STAGE_RECON);
-        ADD( 1,  0, VVC_TASK_STAGE_RECON);
+        ADD_RIGHT(  VVC_TASK_STAGE_RECON);
         ADD(-1, -1, VVC_TASK_STAGE_LMCS);
         ADD( 0, -1, VVC_TASK_STAGE_LMCS);
         ADD(-1,  0, VVC_TASK_STAGE_LMCS);
     } else if (stage == VVC_TASK_STAGE_DEBLOCK_V) {
-        ADD( 1,  0,  VVC_TASK_STAGE_DEBLOCK_V);
+        ADD_RIGHT(   VVC_TASK_STAGE_DEBLOCK_V);
         ADD(-1,  0,  VVC_TASK_STAGE_DEBLOCK_H);
     } else if (stage == VVC_TASK_STAGE_DEBLOCK_H) {
         ADD( 0,  1,  VVC_TASK_STAGE_DEBLOCK_H);
@@ -344,6 +616,8 @@ static void task_stage_done(const VVCTask *t, VVCContext *s)
         ADD( 0,  1,  VVC_TASK_STAGE_ALF);
         ADD( 1,  1,  VVC_TASK_STAGE_ALF);
     }
+
+    return next;
 }
 
 static int task_is_stage_ready(VVCTask *t, int add)
@@ -356,35 +630,32 @@ static int task_is_stage_ready(VVCTask *t, int add)
     return task_has_target_score(t, stage, score);
 }
 
-static int task_ready(const AVTask *_t, void *user_data)
+static int runner_ready(const AVTask *_r, void *user_data)
 {
-    VVCTask *t = (VVCTask*)_t;
-
-    return task_is_stage_ready(t, 0);
+    return 1;
 }
 
-#define CHECK(a, b)                         \
-    do {                                    \
-        if ((a) != (b))                     \
-            return (a) < (b);               \
-    } while (0)
-
-static int task_priority_higher(const AVTask *_a, const AVTask *_b)
+static int runner_priority_higher(const AVTask *_a, const AVTask *_b)
 {
-    const VVCTask *a = (const VVCTask*)_a;
-    const VVCTask *b = (const VVCTask*)_b;
+    const VVCTaskRunner *a = (const VVCTaskRunner*)_a;
+    const VVCTaskRunner *b = (const VVCTaskRunner*)_b;
 
-    CHECK(a->fc->decode_order, b->fc->decode_order);             //decode order
+    //runners of other decoders only meet in a shared executor, first in first out for equal priorities.
+    //The executor only orders the tasks within each per-worker queue, not across them.
+    return a->sched->s->task_priority >= b->sched->s->task_priority;
+}
 
-    if (a->stage == VVC_TASK_STAGE_PARSE || b->stage == VVC_TASK_STAGE_PARSE) {
-        CHECK(a->stage, b->stage);
-        CHECK(a->ry, b->ry);
-        return a->rx < b->rx;
-    }
+static void draw_horiz_band(VVCFrameContext *fc, const int y, const int height)
+{
+    AVCodecContext *avctx = fc->ft->s->avctx;
+    const AVFrame *frame  = fc->frame;
+    int offset[AV_NUM_DATA_POINTERS] = { 0 };
+
+    for (int i = 0; i < VVC_MAX_SAMPLE_ARRAYS && frame->data[i]; i++)
+        offset[i] = (y >> fc->ps.sps->vshift[i]) * frame->linesize[i];
 
-    CHECK(a->rx + a->ry + a->stage, b->rx + b->ry + b->stage);    //zigzag with type
-    CHECK(a->rx + a->ry, b->rx + b->ry);                          //zigzag
-    return a->ry < b->ry;
+    // 3 is PICT_FRAME
+    avctx->draw_horiz_band(avctx, frame, offset, y, 3, height);
 }
 
 static void report_frame_progress(VVCFrameContext *fc,
@@ -404,6 +675,10 @@ static void report_frame_progress(VVCFrameContext *fc,
             const int progress = y == ft->ctu_height ? INT_MAX : y * ctu_size;
             ft->row_progress[idx] = y;
             ff_vvc_report_progress(fc->ref, idx, progress);
+
+            // under ft->lock, so the bands are drawn top to bottom
+            if (idx == VVC_PROGRESS_PIXEL && ft->draw_bands)
+                draw_horiz_band(fc, old * ctu_size, FFMIN(y * ctu_size, fc->ps.pps->height) - old * ctu_size);
         }
         ff_mutex_unlock(&ft->lock);
     }
@@ -490,6 +765,9 @@ static int run_deblock_v(VVCContext *s, VVCLocalContext *lc, VVCTask *t)
     const int y0        = t->ry * ctb_size;
     const int slice_idx = fc->tab.slice_idx[rs];
 
+    if (fc->skip_loop_filter)
+        return 0;
+
     if (slice_idx != -1) {
         lc->sc = fc->slices[slice_idx];
         if (!lc->sc->sh.r->sh_deblocking_filter_disabled_flag) {
@@ -511,6 +789,9 @@ static int run_deblock_h(VVCContext *s, VVCLocalContext *lc, VVCTask *t)
     const int y0        = t->ry * ctb_size;
     const int slice_idx = fc->tab.slice_idx[rs];
 
+    if (fc->skip_loop_filter)
+        return 0;
+
     if (slice_idx != -1) {
         lc->sc = fc->slices[slice_idx];
         if (!lc->sc->sh.r->sh_deblocking_filter_disabled_flag) {
@@ -533,6 +814,9 @@ static int run_sao(VVCContext *s, VVCLocalContext *lc, VVCTask *t)
     const int x0        = t->rx * ctb_size;
     const int y0        = t->ry * ctb_size;
 
+    if (fc->skip_loop_filter)
+        return 0;
+
     if (fc->ps.sps->r->sps_sao_enabled_flag) {
         ff_vvc_decode_neighbour(lc, x0, y0, t->rx, t->ry, rs);
         ff_vvc_sao_filter(lc, x0, y0);
@@ -552,7 +836,7 @@ static int run_alf(VVCContext *s, VVCLocalContext *lc, VVCTask *t)
     const int x0        = t->rx * ctu_size;
     const int y0        = t->ry * ctu_size;
 
-    if (fc->ps.sps->r->sps_alf_enabled_flag) {
+    if (fc->ps.sps->r->sps_alf_enabled_flag && !fc->skip_loop_filter) {
         const int slice_idx = CTB(fc->tab.slice_idx, t->rx, t->ry);
         if (slice_idx != -1) {
             lc->sc = fc->slices[slice_idx];
@@ -560,6 +844,8 @@ static int run_alf(VVCContext *s, VVCLocalContext *lc, VVCTask *t)
             ff_vvc_alf_filter(lc, x0, y0);
         }
     }
+    if (fc->ref_padding)
+        ff_vvc_pad_ctu(fc, fc->frame, t->rx, t->ry);
     report_frame_progress(fc, t->ry, VVC_PROGRESS_PIXEL);
 
     return 0;
@@ -581,7 +867,7 @@ const static char* task_name[] = {
 
 typedef int (*run_func)(VVCContext *s, VVCLocalContext *lc, VVCTask *t);
 
-static void task_run_stage(VVCTask *t, VVCContext *s, VVCLocalContext *lc)
+static VVCTask* task_run_stage(VVCTask *t, VVCContext *s, VVCLocalContext *lc)
 {
     int ret;
     VVCFrameContext *fc      = t->fc;
@@ -603,7 +889,15 @@ static void task_run_stage(VVCTask *t, VVCContext *s, VVCLocalContext *lc)
 #endif
 
     if (!atomic_load(&ft->ret)) {
-        if ((ret = run[stage](s, lc, t)) < 0) {
+        VVCTaskStats *stats = s->scheduler->stats;
+        const int64_t start = stats ? av_gettime_relative() : 0;
+
+        ret = run[stage](s, lc, t);
+        if (stats) {
+            stats_add(&stats->stages[stage].run_time, av_gettime_relative() - start);
+            stats_add(&stats->stages[stage].nb_tasks, 1);
+        }
+        if (ret < 0) {
 #ifdef COMPAT_ATOMICS_WIN32_STDATOMIC_H
             intptr_t zero = 0;
 #else
@@ -616,49 +910,243 @@ static void task_run_stage(VVCTask *t, VVCContext *s, VVCLocalContext *lc)
         }
     }
 
-    task_stage_done(t, s);
-    return;
+    return task_stage_done(t, s);
 }
 
-static int task_run(AVTask *_t, void *local_context, void *user_data)
+static void task_run(VVCTask *t, VVCLocalContext *lc)
 {
-    VVCTask *t          = (VVCTask*)_t;
-    VVCContext *s       = (VVCContext *)user_data;
-    VVCLocalContext *lc = local_context;
     VVCFrameThread *ft  = t->fc->ft;
+    VVCContext *s       = ft->s;
 
     lc->fc = t->fc;
 
-    do {
-        task_run_stage(t, s, lc);
-        t->stage++;
-    } while (task_is_stage_ready(t, 1));
+    // the claimed tasks are covered by the scheduled count of the first one
+    while (t) {
+        VVCTask *next = NULL;
+
+        do {
+            VVCTask *right = task_run_stage(t, s, lc);
+            if (right) {
+                if (next)
+                    add_task(s, next);
+                next = right;
+            }
+            t->stage++;
+        } while (task_is_stage_ready(t, 1));
+
+        if (t->stage != VVC_TASK_STAGE_LAST)
+            frame_thread_add_score(s, ft, t->rx, t->ry, t->stage);
+
+        t = next;
+    }
+}
+
+static int runner_run(AVTask *_r, void *local_context, void *user_data)
+{
+    VVCTaskRunner *r    = (VVCTaskRunner*)_r;
+    VVCScheduler *sched = r->sched;
+    AVExecutor *e       = sched->s->executor;
+    int (*job)(VVCContext *s);
+    VVCFrameThread *ft  = NULL;
+    VVCTask *t          = NULL;
+    int requeue;
+
+    // the caller waits for the job, it goes first
+    scheduler_lock(sched);
+    job        = sched->job;
+    sched->job = NULL;
+    if (!job)
+        t = scheduler_pop(sched);
+    if (!job && !t)
+        scheduler_park_runner(sched, r);
+    ff_mutex_unlock(&sched->lock);
+
+    if (job) {
+        const int ret = job(sched->s);
+
+        scheduler_lock(sched);
+        sched->job_ret     = ret;
+        sched->job_pending = 0;
+        ff_cond_broadcast(&sched->cond);
+        ff_mutex_unlock(&sched->lock);
+    } else if (t) {
+        ft = t->fc->ft;
+        task_run(t, local_context);
+    } else {
+        return 0;
+    }
+
+    // this may finish the frame, the decoder is only closed once every runner is parked
+    if (ft)
+        sheduled_done(ft, &ft->nb_scheduled_tasks);
 
-    if (t->stage != VVC_TASK_STAGE_LAST)
-        frame_thread_add_score(s, ft, t->rx, t->ry, t->stage);
+    // keep the runner queued while there is work, park it otherwise
+    scheduler_lock(sched);
+    requeue = sched->nb_frames > 0 || sched->job;
+    if (!requeue)
+        scheduler_park_runner(sched, r);
+    ff_mutex_unlock(&sched->lock);
 
-    sheduled_done(ft, &ft->nb_scheduled_tasks);
+    // do not touch the scheduler after parking
+    if (requeue)
+        av_executor_execute(e, &r->task);
 
     return 0;
 }
 
-AVExecutor* ff_vvc_executor_alloc(VVCContext *s, const int thread_count)
+static AVMutex shared_executor_lock = AV_MUTEX_INITIALIZER;
+static AVExecutor *shared_executor;
+static int shared_executor_users;
+
+static AVExecutor* executor_alloc(VVCContext *s, const int thread_count)
 {
     AVTaskCallbacks callbacks = {
         s,
         sizeof(VVCLocalContext),
-        task_priority_higher,
-        task_ready,
-        task_run,
+        runner_priority_higher,
+        runner_ready,
+        runner_run,
     };
-    return av_executor_alloc(&callbacks, thread_count);
+    AVExecutor *e;
+
+    if (!s->shared_executor)
+        return av_executor_alloc(&callbacks, thread_count);
+
+    // runners find their decoder through the scheduler, user_data is unused
+    callbacks.user_data = &shared_executor;
+
+    ff_mutex_lock(&shared_executor_lock);
+    if (!shared_executor)
+        shared_executor = av_executor_alloc(&callbacks, thread_count);
+    if (shared_executor)
+        shared_executor_users++;
+    e = shared_executor;
+    ff_mutex_unlock(&shared_executor_lock);
+
+    return e;
 }
 
-void ff_vvc_executor_free(AVExecutor **e)
+static void executor_free(AVExecutor **e)
 {
+    if (!*e)
+        return;
+
+    ff_mutex_lock(&shared_executor_lock);
+    if (*e == shared_executor) {
+        if (!--shared_executor_users)
+            av_executor_free(&shared_executor);
+        *e = NULL;
+    }
+    ff_mutex_unlock(&shared_executor_lock);
+
     av_executor_free(e);
 }
 
+static void scheduler_free(VVCScheduler **sched)
+{
+    VVCScheduler *sc = *sched;
+
+    if (!sc)
+        return;
+
+    ff_cond_destroy(&sc->cond);
+    ff_mutex_destroy(&sc->lock);
+    av_freep(&sc->stats);
+    av_freep(&sc->runners);
+    av_freep(&sc->frames);
+    av_freep(sched);
+}
+
+static VVCScheduler* scheduler_alloc(VVCContext *s, const int nb_runners)
+{
+    VVCScheduler *sched = av_mallocz(sizeof(*sched));
+
+    if (!sched)
+        return NULL;
+
+    if (ff_mutex_init(&sched->lock, NULL)) {
+        av_free(sched);
+        return NULL;
+    }
+    if (ff_cond_init(&sched->cond, NULL)) {
+        ff_mutex_destroy(&sched->lock);
+        av_free(sched);
+        return NULL;
+    }
+
+    sched->s          = s;
+    sched->max_frames = s->max_fcs;
+    sched->frames     = av_calloc(sched->max_frames, sizeof(*sched->frames));
+    sched->runners    = av_calloc(nb_runners, sizeof(*sched->runners));
+    sched->stats      = s->task_stats ? av_mallocz(sizeof(*sched->stats)) : NULL;
+    if (!sched->frames || !sched->runners || (s->task_stats && !sched->stats)) {
+        scheduler_free(&sched);
+        return NULL;
+    }
+
+    sched->nb_runners   = nb_runners;
+    sched->sample_idle  = s->nb_fcs < s->max_fcs;
+    sched->idle_stamp   = sched->sample_idle ? av_gettime_relative() : 0;
+    sched->sample_start = sched->idle_stamp;
+    for (int i = 0; i < nb_runners; i++) {
+        VVCTaskRunner *r = sched->runners + i;
+        r->sched = sched;
+        scheduler_park_runner(sched, r);
+    }
+
+    return sched;
+}
+
+int ff_vvc_executor_alloc(VVCContext *s, const int thread_count)
+{
+    s->scheduler = scheduler_alloc(s, FFMAX(thread_count, 1));
+    if (!s->scheduler)
+        return AVERROR(ENOMEM);
+
+    s->executor = executor_alloc(s, thread_count);
+    if (!s->executor)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static void stats_log(VVCContext *s, const VVCTaskStats *stats)
+{
+    static const char *const stage_name[] = {
+        "parse", "inter", "recon", "lmcs", "deblock_v", "deblock_h", "sao", "alf"
+    };
+
+    av_log(s->avctx, AV_LOG_INFO, "%-10s %10s %12s %12s %12s\n",
+        "stage", "tasks", "run ms", "ready ms", "wait ms");
+    for (int i = 0; i < VVC_TASK_STAGE_LAST; i++) {
+        const VVCStageStats *st = stats->stages + i;
+        av_log(s->avctx, AV_LOG_INFO, "%-10s %10"PRId64" %12.3f %12.3f %12.3f\n", stage_name[i],
+            (int64_t)atomic_load(&st->nb_tasks),
+            atomic_load(&st->run_time)   / 1000.0,
+            atomic_load(&st->ready_time) / 1000.0,
+            atomic_load(&st->wait_time)  / 1000.0);
+    }
+    av_log(s->avctx, AV_LOG_INFO, "scheduler lock: %"PRId64" acquisitions, %.3f ms waiting\n",
+        (int64_t)atomic_load(&stats->nb_locks), atomic_load(&stats->lock_time) / 1000.0);
+}
+
+void ff_vvc_executor_free(VVCContext *s)
+{
+    VVCScheduler *sched = s->scheduler;
+
+    if (sched && s->executor) {
+        // a runner may still be queued after the last task finished, wait for it to park
+        ff_mutex_lock(&sched->lock);
+        while (sched->nb_idle != sched->nb_runners)
+            ff_cond_wait(&sched->cond, &sched->lock);
+        ff_mutex_unlock(&sched->lock);
+    }
+    if (sched && sched->stats)
+        stats_log(s, sched->stats);
+    executor_free(&s->executor);
+    scheduler_free(&s->scheduler);
+}
+
 void ff_vvc_frame_thread_free(VVCFrameContext *fc)
 {
     VVCFrameThread *ft = fc->ft;
@@ -789,10 +1277,63 @@ static void submit_entry_point(VVCContext *s, VVCFrameThread *ft, SliceContext *
     frame_thread_add_score(s, ft, t->rx, t->ry, VVC_TASK_STAGE_PARSE);
 }
 
+static int use_row_tasks(const VVCContext *s, const VVCFrameContext *fc)
+{
+    if (s->task_granularity != VVC_TASK_GRANULARITY_AUTO)
+        return s->task_granularity == VVC_TASK_GRANULARITY_ROW;
+
+    // the tasks are too short to amortize going through the scheduler, while
+    // large pictures have enough rows in flight to keep the workers busy anyway
+    return fc->ps.sps->ctb_size_y <= 64 && fc->ps.pps->width * fc->ps.pps->height <= 1280 * 720;
+}
+
+/*
+ * Callers of draw_horiz_band expect serial calls in output order. Only hand out
+ * the bands of output frames of a stream without reordering, decoded one frame
+ * at a time. The bands of a frame are drawn under ft->lock, and the next frame
+ * is only submitted once this one is done.
+ */
+static int use_draw_horiz_band(const VVCContext *s, const VVCFrameContext *fc)
+{
+    const H266RawSPS *rsps = fc->ps.sps->r;
+
+    return s->avctx->draw_horiz_band && s->max_fcs == 1 &&
+        !rsps->sps_dpb_params.dpb_max_num_reorder_pics[rsps->sps_max_sublayers_minus1] &&
+        (fc->ref->flags & VVC_FRAME_FLAG_OUTPUT);
+}
+
+// CTUs of skipped or missing slices are never decoded, they count as done like the picture borders
+static void frame_thread_skip_ctus(VVCFrameContext *fc)
+{
+    VVCFrameThread *ft = fc->ft;
+    VVCTask task;
+
+    for (int rs = 0; rs < ft->ctu_count; rs++) {
+        if (fc->tab.slice_idx[rs] != -1)
+            continue;
+
+        task_init(&task, VVC_TASK_STAGE_RECON, fc, rs % ft->ctu_width, rs / ft->ctu_width);
+        // later pictures read the collocated motion field, and the loop filters of parsed neighbours the rest
+        ff_vvc_ctu_init_tabs(fc, task.rx, task.ry);
+        for (int i = VVC_TASK_STAGE_RECON; i < VVC_TASK_STAGE_LAST; i++) {
+            task.stage = i;
+            task_stage_done(&task, NULL);
+        }
+        report_frame_progress(fc, task.ry, VVC_PROGRESS_MV);
+        report_frame_progress(fc, task.ry, VVC_PROGRESS_PIXEL);
+    }
+}
+
 void ff_vvc_frame_submit(VVCContext *s, VVCFrameContext *fc)
 {
     VVCFrameThread *ft = fc->ft;
 
+    ft->s         = s;
+    ft->row_tasks  = use_row_tasks(s, fc);
+    ft->draw_bands = use_draw_horiz_band(s, fc);
+
+    frame_thread_skip_ctus(fc);
+
     for (int i = 0; i < fc->nb_slices; i++) {
         SliceContext *sc = fc->slices[i];
         for (int j = 0; j < sc->nb_eps; j++) {
@@ -809,16 +1350,103 @@ void ff_vvc_frame_submit(VVCContext *s, VVCFrameContext *fc)
     }
 }
 
-int ff_vvc_frame_wait(VVCContext *s, VVCFrameContext *fc)
+void ff_vvc_job_submit(VVCContext *s, int (*job)(VVCContext *s))
+{
+    VVCScheduler *sched = s->scheduler;
+    VVCTaskRunner *runner;
+
+    scheduler_lock(sched);
+    av_assert0(!sched->job_pending);
+    sched->job         = job;
+    sched->job_pending = 1;
+    runner = scheduler_get_idle_runner(sched);
+    ff_mutex_unlock(&sched->lock);
+
+    if (runner)
+        av_executor_execute(s->executor, &runner->task);
+}
+
+int ff_vvc_job_wait(VVCContext *s)
+{
+    VVCScheduler *sched = s->scheduler;
+    int ret;
+
+    ff_mutex_lock(&sched->lock);
+    while (sched->job_pending)
+        ff_cond_wait(&sched->cond, &sched->lock);
+    ret = sched->job_ret;
+    sched->job_ret = 0;
+    ff_mutex_unlock(&sched->lock);
+
+    return ret;
+}
+
+int ff_vvc_frame_is_done(VVCFrameContext *fc)
 {
     VVCFrameThread *ft = fc->ft;
 
+    return !atomic_load(&ft->nb_scheduled_tasks) && !atomic_load(&ft->nb_scheduled_listeners);
+}
+
+int ff_vvc_executor_starved(VVCContext *s)
+{
+    VVCScheduler *sched = s->scheduler;
+    int64_t now;
+    int starved;
+
+    if (!sched->sample_idle)
+        return 0;
+
+    /*
+     * Idle while the caller waits means the frames in flight have no ready task
+     * left; count it once it is over a quarter of the runner time of the sample.
+     * A single runner gains nothing from more frames.
+     */
+    scheduler_lock(sched);
+    now     = av_gettime_relative();
+    starved = sched->nb_runners > 1 &&
+        4 * sched->wait_idle_time > sched->nb_runners * (now - sched->sample_start);
+    sched->wait_idle_time = 0;
+    sched->sample_start   = now;
+    ff_mutex_unlock(&sched->lock);
+
+    return starved;
+}
+
+void ff_vvc_executor_stop_sampling(VVCContext *s)
+{
+    VVCScheduler *sched = s->scheduler;
+
+    // runners read it under the lock, the caller is the only writer
+    scheduler_lock(sched);
+    sched->sample_idle = 0;
+    ff_mutex_unlock(&sched->lock);
+}
+
+int ff_vvc_frame_wait(VVCContext *s, VVCFrameContext *fc)
+{
+    VVCScheduler *sched = s->scheduler;
+    VVCFrameThread *ft  = fc->ft;
+    int64_t idle_time   = 0;
+
+    if (sched->sample_idle) {
+        scheduler_lock(sched);
+        idle_time = scheduler_update_idle_time(sched);
+        ff_mutex_unlock(&sched->lock);
+    }
+
     ff_mutex_lock(&ft->lock);
 
     while (atomic_load(&ft->nb_scheduled_tasks) || atomic_load(&ft->nb_scheduled_listeners))
         ff_cond_wait(&ft->cond, &ft->lock);
 
     ff_mutex_unlock(&ft->lock);
+
+    if (sched->sample_idle) {
+        scheduler_lock(sched);
+        sched->wait_idle_time += scheduler_update_idle_time(sched) - idle_time;
+        ff_mutex_unlock(&sched->lock);
+    }
     ff_vvc_report_frame_finished(fc->ref);
 
 #ifdef VVC_THREAD_DEBUG
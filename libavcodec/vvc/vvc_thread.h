@@ -25,12 +25,43 @@
 
 #include "vvcdec.h"
 
-struct AVExecutor* ff_vvc_executor_alloc(VVCContext *s, int thread_count);
-void ff_vvc_executor_free(struct AVExecutor **e);
+int ff_vvc_executor_alloc(VVCContext *s, int thread_count);
+void ff_vvc_executor_free(VVCContext *s);
 
 int ff_vvc_frame_thread_init(VVCFrameContext *fc);
 void ff_vvc_frame_thread_free(VVCFrameContext *fc);
 void ff_vvc_frame_submit(VVCContext *s, VVCFrameContext *fc);
 int ff_vvc_frame_wait(VVCContext *s, VVCFrameContext *fc);
 
+/**
+ * Check without blocking whether all the tasks of a submitted frame have finished,
+ * ff_vvc_frame_wait() returns immediately then.
+ */
+int ff_vvc_frame_is_done(VVCFrameContext *fc);
+
+/**
+ * Check whether the workers were left without ready tasks for a sizable part of
+ * the time since the last call, while the caller waited for a frame in
+ * ff_vvc_frame_wait(). Always 0 unless the frame window may grow.
+ */
+int ff_vvc_executor_starved(VVCContext *s);
+
+/**
+ * Stop timing the idle runners once the frame window can not grow anymore,
+ * ff_vvc_executor_starved() returns 0 from then on.
+ */
+void ff_vvc_executor_stop_sampling(VVCContext *s);
+
+/**
+ * Run job on a worker ahead of the CTU tasks. Only one job may be
+ * pending at a time.
+ */
+void ff_vvc_job_submit(VVCContext *s, int (*job)(VVCContext *s));
+
+/**
+ * Wait for the job submitted by ff_vvc_job_submit(), in the same decode call.
+ * @return the return value of the job
+ */
+int ff_vvc_job_wait(VVCContext *s);
+
 #endif // AVCODEC_VVC_VVC_THREAD_H
@@ -25,6 +25,7 @@
 #include "libavcodec/profiles.h"
 #include "libavcodec/refstruct.h"
 #include "libavutil/cpu.h"
+#include "libavutil/opt.h"
 #include "libavutil/thread.h"
 
 #include "vvcdec.h"
@@ -44,7 +45,6 @@ typedef struct TabList {
     Tab tabs[TAB_MAX];
     int nb_tabs;
 
-    int zero;
     int realloc;
 } TabList;
 
@@ -55,10 +55,9 @@ typedef struct TabList {
     l->nb_tabs++;                                        \
 } while (0)
 
-static void tl_init(TabList *l, const int zero, const int realloc)
+static void tl_init(TabList *l, const int realloc)
 {
     l->nb_tabs = 0;
-    l->zero = zero;
     l->realloc = realloc;
 }
 
@@ -77,15 +76,10 @@ static int tl_create(TabList *l)
 
         for (int i = 0; i < l->nb_tabs; i++) {
             Tab *t = l->tabs + i;
-            *t->tab = l->zero ? av_mallocz(t->size) : av_malloc(t->size);
+            *t->tab = av_malloc(t->size);
             if (!*t->tab)
                 return AVERROR(ENOMEM);
         }
-    } else if (l->zero) {
-        for (int i = 0; i < l->nb_tabs; i++) {
-            Tab *t = l->tabs + i;
-            memset(*t->tab, 0, t->size);
-        }
     }
     return 0;
 }
@@ -98,14 +92,13 @@ static void ctu_nz_tl_init(TabList *l, VVCFrameContext *fc)
     const int ctu_count = pps ? pps->ctb_count : 0;
     const int changed   = fc->tab.sz.ctu_count != ctu_count || fc->tab.sz.ctu_size != ctu_size;
 
-    tl_init(l, 0, changed);
+    tl_init(l, changed);
 
     TL_ADD(ctus,    ctu_count);
     TL_ADD(deblock, ctu_count);
     TL_ADD(sao,     ctu_count);
     TL_ADD(alf,     ctu_count);
     TL_ADD(slice_idx, ctu_count);
-    TL_ADD(coeffs,    ctu_count * ctu_size * VVC_MAX_SAMPLE_ARRAYS);
 }
 
 static void min_cb_nz_tl_init(TabList *l, VVCFrameContext *fc)
@@ -114,7 +107,7 @@ static void min_cb_nz_tl_init(TabList *l, VVCFrameContext *fc)
     const int pic_size_in_min_cb = pps ? pps->min_cb_width * pps->min_cb_height : 0;
     const int changed            = fc->tab.sz.pic_size_in_min_cb != pic_size_in_min_cb;
 
-    tl_init(l, 0, changed);
+    tl_init(l, changed);
 
     TL_ADD(imf,  pic_size_in_min_cb);
     TL_ADD(imtf, pic_size_in_min_cb);
@@ -141,7 +134,7 @@ static void min_pu_nz_tl_init(TabList *l, VVCFrameContext *fc)
     const int pic_size_in_min_pu = pps ? pps->min_pu_width * pps->min_pu_height : 0;
     const int changed            = fc->tab.sz.pic_size_in_min_pu != pic_size_in_min_pu;
 
-    tl_init(l, 0, changed);
+    tl_init(l, changed);
 
     TL_ADD(msf, pic_size_in_min_pu);
     TL_ADD(mmi, pic_size_in_min_pu);
@@ -154,7 +147,7 @@ static void min_tu_nz_tl_init(TabList *l, VVCFrameContext *fc)
     const int pic_size_in_min_tu = pps ? pps->min_tu_width * pps->min_tu_height : 0;
     const int changed            = fc->tab.sz.pic_size_in_min_tu != pic_size_in_min_tu;
 
-    tl_init(l, 0, changed);
+    tl_init(l, changed);
 
     TL_ADD(tu_joint_cbcr_residual_flag, pic_size_in_min_tu);
     for (int i = LUMA; i < VVC_MAX_SAMPLE_ARRAYS; i++) {
@@ -192,7 +185,7 @@ static void pixel_buffer_nz_tl_init(TabList *l, VVCFrameContext *fc)
         fc->tab.sz.width != width || fc->tab.sz.height != height ||
         fc->tab.sz.ctu_width != ctu_width || fc->tab.sz.ctu_height != ctu_height;
 
-    tl_init(l, 0, changed);
+    tl_init(l, changed);
 
     for (int c_idx = 0; c_idx < c_end; c_idx++) {
         const int w = width  >> (sps ? sps->hshift[c_idx] : 0);
@@ -220,7 +213,7 @@ static void msm_tl_init(TabList *l, VVCFrameContext *fc)
     const int changed = AV_CEIL_RSHIFT(fc->tab.sz.width,  5) != w32 ||
         AV_CEIL_RSHIFT(fc->tab.sz.height,  5) != h32;
 
-    tl_init(l, 1, changed);
+    tl_init(l, changed);
 
     for (int i = LUMA; i <= CHROMA; i++)
         TL_ADD(msm[i], w32 * h32);
@@ -234,7 +227,7 @@ static void ispmf_tl_init(TabList *l, VVCFrameContext *fc)
     const int changed = AV_CEIL_RSHIFT(fc->tab.sz.width,  6) != w64 ||
         AV_CEIL_RSHIFT(fc->tab.sz.height,  6) != h64;
 
-    tl_init(l, 1, changed);
+    tl_init(l, changed);
 
     TL_ADD(ispmf, w64 * h64);
 }
@@ -278,7 +271,9 @@ static void pic_arrays_free(VVCFrameContext *fc)
     free_cus(fc);
     frame_context_for_each_tl(fc, tl_free);
     ff_refstruct_pool_uninit(&fc->rpl_tab_pool);
-    ff_refstruct_pool_uninit(&fc->tab_dmvr_mvf_pool);
+    ff_refstruct_pool_uninit(&fc->rpl_pool);
+    ff_refstruct_pool_uninit(&fc->progress_pool);
+    ff_refstruct_pool_uninit(&fc->tab_col_mvf_pool);
 
     memset(&fc->tab.sz, 0, sizeof(fc->tab.sz));
 }
@@ -299,6 +294,10 @@ static int pic_arrays_init(VVCContext *s, VVCFrameContext *fc)
 
     memset(fc->tab.slice_idx, -1, sizeof(*fc->tab.slice_idx) * ctu_count);
 
+    // CTUs own pooled references, freshly allocated ones must not point anywhere
+    if (fc->tab.sz.ctu_count != ctu_count || fc->tab.sz.ctu_size != 1 << sps->ctb_log2_size_y << sps->ctb_log2_size_y)
+        memset(fc->tab.ctus, 0, sizeof(*fc->tab.ctus) * ctu_count);
+
     if (fc->tab.sz.ctu_count != ctu_count) {
         ff_refstruct_pool_uninit(&fc->rpl_tab_pool);
         fc->rpl_tab_pool = ff_refstruct_pool_alloc(ctu_count * sizeof(RefPicListTab), 0);
@@ -306,11 +305,28 @@ static int pic_arrays_init(VVCContext *s, VVCFrameContext *fc)
             return AVERROR(ENOMEM);
     }
 
-    if (fc->tab.sz.pic_size_in_min_pu != pic_size_in_min_pu) {
-        ff_refstruct_pool_uninit(&fc->tab_dmvr_mvf_pool);
-        fc->tab_dmvr_mvf_pool = ff_refstruct_pool_alloc(
-            pic_size_in_min_pu * sizeof(MvField), FF_REFSTRUCT_POOL_FLAG_ZERO_EVERY_TIME);
-        if (!fc->tab_dmvr_mvf_pool)
+    if (fc->tab.sz.ctu_height != pps->ctb_height) {
+        ff_refstruct_pool_uninit(&fc->progress_pool);
+        fc->progress_pool = ff_vvc_progress_pool_alloc(pps->ctb_height);
+        if (!fc->progress_pool)
+            return AVERROR(ENOMEM);
+    }
+
+    // one RefPicListTab per unit in the access unit, grown on demand
+    if (fc->tab.sz.nb_rpl_elems < s->current_frame.nb_units) {
+        ff_refstruct_pool_uninit(&fc->rpl_pool);
+        fc->rpl_pool = ff_refstruct_pool_alloc(s->current_frame.nb_units * sizeof(RefPicListTab),
+            FF_REFSTRUCT_POOL_FLAG_ZERO_EVERY_TIME);
+        if (!fc->rpl_pool)
+            return AVERROR(ENOMEM);
+        fc->tab.sz.nb_rpl_elems = s->current_frame.nb_units;
+    }
+
+    if (fc->tab.sz.width != pps->width || fc->tab.sz.height != pps->height) {
+        ff_refstruct_pool_uninit(&fc->tab_col_mvf_pool);
+        fc->tab_col_mvf_pool = ff_refstruct_pool_alloc(
+            pps->width8 * pps->height8 * sizeof(ColMvField), 0);
+        if (!fc->tab_col_mvf_pool)
             return AVERROR(ENOMEM);
     }
 
@@ -496,6 +512,12 @@ static VVCFrameContext* get_frame_context(const VVCContext *s, const VVCFrameCon
     return s->fcs + idx;
 }
 
+// frame context of the n-th frame in decode order
+static VVCFrameContext* frame_context_of(const VVCContext *s, const uint64_t n)
+{
+    return s->fcs + (n - s->fc_base) % s->nb_fcs;
+}
+
 static int ref_frame(VVCFrame *dst, const VVCFrame *src)
 {
     int ret;
@@ -506,7 +528,7 @@ static int ref_frame(VVCFrame *dst, const VVCFrame *src)
 
     ff_refstruct_replace(&dst->progress, src->progress);
 
-    ff_refstruct_replace(&dst->tab_dmvr_mvf, src->tab_dmvr_mvf);
+    ff_refstruct_replace(&dst->tab_col_mvf, src->tab_col_mvf);
 
     ff_refstruct_replace(&dst->rpl_tab, src->rpl_tab);
     ff_refstruct_replace(&dst->rpl, src->rpl);
@@ -524,6 +546,7 @@ static av_cold void frame_context_free(VVCFrameContext *fc)
 {
     slices_free(fc);
 
+    ff_refstruct_pool_uninit(&fc->coeff_pool);
     ff_refstruct_pool_uninit(&fc->tu_pool);
     ff_refstruct_pool_uninit(&fc->cu_pool);
 
@@ -540,8 +563,10 @@ static av_cold void frame_context_free(VVCFrameContext *fc)
 
 static av_cold int frame_context_init(VVCFrameContext *fc, AVCodecContext *avctx)
 {
+    const VVCContext *s = avctx->priv_data;
 
-    fc->log_ctx = avctx;
+    fc->log_ctx     = avctx;
+    fc->ref_padding = s->pad_refs ? REF_PADDING : 0;
 
     fc->output_frame = av_frame_alloc();
     if (!fc->output_frame)
@@ -560,6 +585,10 @@ static av_cold int frame_context_init(VVCFrameContext *fc, AVCodecContext *avctx
     if (!fc->tu_pool)
         return AVERROR(ENOMEM);
 
+    fc->coeff_pool = ff_refstruct_pool_alloc(sizeof(CoeffBlock), 0);
+    if (!fc->coeff_pool)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -595,14 +624,9 @@ static int frame_context_setup(VVCFrameContext *fc, VVCContext *s)
 
 static int frame_start(VVCContext *s, VVCFrameContext *fc, SliceContext *sc)
 {
-    const VVCPH *ph                 = &fc->ps.ph;
     const H266RawSliceHeader *rsh   = sc->sh.r;
     int ret;
 
-    // 8.3.1 Decoding process for picture order count
-    if (!s->temporal_id && !ph->r->ph_non_ref_pic_flag && !(IS_RASL(s) || IS_RADL(s)))
-        s->poc_tid0 = ph->poc;
-
     if ((ret = ff_vvc_set_new_ref(s, fc, &fc->frame)) < 0)
         goto fail;
 
@@ -678,10 +702,15 @@ static void export_frame_params(VVCContext *s, const VVCFrameContext *fc)
 
 static int frame_setup(VVCFrameContext *fc, VVCContext *s)
 {
+    const VVCPH *ph = &fc->ps.ph;
     int ret = ff_vvc_decode_frame_ps(&fc->ps, s);
     if (ret < 0)
         return ret;
 
+    // 8.3.1 Decoding process for picture order count, also for discarded frames
+    if (!s->temporal_id && !ph->r->ph_non_ref_pic_flag && !(IS_RASL(s) || IS_RADL(s)))
+        s->poc_tid0 = ph->poc;
+
     ret = frame_context_setup(fc, s);
     if (ret < 0)
         return ret;
@@ -690,12 +719,73 @@ static int frame_setup(VVCFrameContext *fc, VVCContext *s)
     return ret;
 }
 
+static int is_discarded(const VVCContext *s, const VVCFrameContext *fc,
+    const H266RawSliceHeader *rsh, const enum AVDiscard skip)
+{
+    return  skip >= AVDISCARD_ALL                                   ||
+           (skip >= AVDISCARD_NONKEY   && !IS_IRAP(s))              ||
+           (skip >= AVDISCARD_NONINTRA && !IS_I(rsh))               ||
+           (skip >= AVDISCARD_BIDIR    && IS_B(rsh))                ||
+           (skip >= AVDISCARD_NONREF   && fc->ps.ph.r->ph_non_ref_pic_flag);
+}
+
+static int is_roi_subpic(const VVCContext *s, const int id)
+{
+    for (int i = 0; i < s->nb_roi_subpic_ids; i++) {
+        if (s->roi_subpic_ids[i] == id)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Slices outside the subpictures listed in the subpics option are not decoded.
+ * This is only done if the listed subpictures are treated as pictures and not
+ * filtered across their edges, then neither the motion compensation nor the
+ * in-loop filters read the skipped areas. Otherwise the whole frame is decoded.
+ */
+static int decode_roi_only(VVCContext *s, const VVCFrameContext *fc)
+{
+    const H266RawSPS *rsps = fc->ps.sps->r;
+    const H266RawPPS *rpps = fc->ps.pps->r;
+    const char *fallback   = NULL;
+
+    if (!s->nb_roi_subpic_ids)
+        return 0;
+
+    if (!rsps->sps_subpic_info_present_flag) {
+        fallback = "The stream has no subpictures";
+    } else {
+        int nb_found = 0;
+
+        for (int i = 0; i <= rsps->sps_num_subpics_minus1; i++) {
+            if (!is_roi_subpic(s, rpps->sub_pic_id_val[i]))
+                continue;
+            nb_found++;
+            if (!rsps->sps_subpic_treated_as_pic_flag[i] ||
+                rsps->sps_loop_filter_across_subpic_enabled_flag[i])
+                fallback = "A listed subpicture is not independently decodable";
+        }
+        if (!nb_found)
+            fallback = "None of the listed subpictures exists";
+    }
+
+    if (fallback && !s->roi_fallback)
+        av_log(s->avctx, AV_LOG_WARNING, "%s, decoding all subpictures.\n", fallback);
+    s->roi_fallback = !!fallback;
+
+    return !fallback;
+}
+
 static int decode_slice(VVCContext *s, VVCFrameContext *fc, const H2645NAL *nal, const CodedBitstreamUnit *unit)
 {
     int ret;
     SliceContext *sc;
     const int is_first_slice = !fc->nb_slices;
 
+    if (fc->skip_frame)
+        return 0;
+
     ret = slices_realloc(fc);
     if (ret < 0)
         return ret;
@@ -704,15 +794,33 @@ static int decode_slice(VVCContext *s, VVCFrameContext *fc, const H2645NAL *nal,
 
     s->vcl_unit_type = nal->type;
     if (is_first_slice) {
+        const AVCodecContext *avctx   = s->avctx;
+        const H266RawSlice *slice     = unit->content_ref;
+
         ret = frame_setup(fc, s);
         if (ret < 0)
             return ret;
+
+        // the first slice decides for the whole frame
+        fc->skip_frame = is_discarded(s, fc, &slice->header, avctx->skip_frame);
+        if (fc->skip_frame)
+            return 0;
+        fc->skip_loop_filter = is_discarded(s, fc, &slice->header, avctx->skip_loop_filter);
+        fc->skip_idct        = is_discarded(s, fc, &slice->header, avctx->skip_idct);
+        fc->roi_only         = decode_roi_only(s, fc);
     }
 
     ret = slice_start(sc, s, fc, unit, is_first_slice);
     if (ret < 0)
         return ret;
 
+    // no entry points, its CTUs keep slice_idx -1 and are never scheduled
+    if (fc->roi_only && !is_roi_subpic(s, sc->sh.r->sh_subpic_id)) {
+        eps_free(sc);
+        fc->nb_slices++;
+        return 0;
+    }
+
     ret = slice_init_entry_points(sc, fc, nal, unit);
     if (ret < 0)
         return ret;
@@ -756,21 +864,27 @@ static int decode_nal_unit(VVCContext *s, VVCFrameContext *fc, const H2645NAL *n
     return 0;
 }
 
-static int decode_nal_units(VVCContext *s, VVCFrameContext *fc, AVPacket *avpkt)
+static int read_packet(VVCContext *s, AVPacket *avpkt)
+{
+    CodedBitstreamFragment *frame = &s->current_frame;
+    int ret;
+
+    ff_cbs_fragment_reset(frame);
+    ret = ff_cbs_read_packet(s->cbc, frame, avpkt);
+    if (ret < 0)
+        av_log(s->avctx, AV_LOG_ERROR, "Failed to read packet.\n");
+    return ret;
+}
+
+static int decode_nal_units(VVCContext *s, VVCFrameContext *fc)
 {
     const CodedBitstreamH266Context *h266 = s->cbc->priv_data;
-    CodedBitstreamFragment *frame         = &s->current_frame;
+    const CodedBitstreamFragment *frame   = &s->current_frame;
     int ret = 0;
     int eos_at_start = 1;
     s->last_eos = s->eos;
     s->eos = 0;
 
-    ff_cbs_fragment_reset(frame);
-    ret = ff_cbs_read_packet(s->cbc, frame, avpkt);
-    if (ret < 0) {
-        av_log(s->avctx, AV_LOG_ERROR, "Failed to read packet.\n");
-        return ret;
-    }
     /* decode the NAL units */
     for (int i = 0; i < frame->nb_units; i++) {
         const H2645NAL *nal            = h266->common.read_packet.nals + i;
@@ -813,7 +927,7 @@ static int set_output_format(const VVCContext *s, const AVFrame *output)
 
 static int wait_delayed_frame(VVCContext *s, AVFrame *output, int *got_output)
 {
-    VVCFrameContext *delayed = get_frame_context(s, s->fcs, s->nb_frames - s->nb_delayed);
+    VVCFrameContext *delayed = frame_context_of(s, s->nb_frames - s->nb_delayed);
     int ret                  = ff_vvc_frame_wait(s, delayed);
 
     if (!ret && delayed->output_frame->buf[0] && output) {
@@ -827,19 +941,103 @@ static int wait_delayed_frame(VVCContext *s, AVFrame *output, int *got_output)
     return ret;
 }
 
-static int submit_frame(VVCContext *s, VVCFrameContext *fc, AVFrame *output, int *got_output)
+static int oldest_frame_is_done(VVCContext *s)
 {
+    VVCFrameContext *oldest = frame_context_of(s, s->nb_frames - s->nb_delayed);
+
+    return ff_vvc_frame_is_done(oldest);
+}
+
+/*
+ * Add a frame context to the window if it is full while workers are idle,
+ * waiting on the dependencies between the frames in flight. Starvation is
+ * sampled over a whole lap of the ring. The new one goes after the last of
+ * the current lap so the ring keeps its order. The window never shrinks:
+ * the contexts are allocated up front, and dropping one would reorder the
+ * ring under the frames in flight.
+ */
+static int grow_frame_window(VVCContext *s)
+{
+    if (s->nb_fcs >= s->max_fcs || (s->nb_frames - s->fc_base) % s->nb_fcs ||
+        !ff_vvc_executor_starved(s))
+        return 0;
+
+    s->fc_base = s->nb_frames - s->nb_fcs;
+    s->nb_fcs++;
+    av_log(s->avctx, AV_LOG_DEBUG, "%d frames in flight\n", s->nb_fcs);
+    // the park and wake of every runner reads the clock while sampling
+    if (s->nb_fcs == s->max_fcs)
+        ff_vvc_executor_stop_sampling(s);
+
+    return 1;
+}
+
+static int output_ready(VVCContext *s)
+{
+    if (s->nb_delayed >= s->nb_fcs && !grow_frame_window(s))
+        return 1;
+    return s->sliding_output && s->nb_delayed && oldest_frame_is_done(s);
+}
+
+// decode the units read by read_packet() and submit their frame, without waiting for any frame
+static int decode_packet(VVCContext *s)
+{
+    VVCFrameContext *fc = frame_context_of(s, s->nb_frames);
     int ret;
+
+    fc->nb_slices = 0;
+    fc->decode_order = s->nb_frames;
+    fc->skip_frame = 0;
+
+    ret = decode_nal_units(s, fc);
+    // nothing to submit for a discarded frame or a packet without slices
+    if (ret < 0 || fc->skip_frame || !fc->nb_slices)
+        return ret;
+
     s->nb_frames++;
     s->nb_delayed++;
     ff_vvc_frame_submit(s, fc);
-    if (s->nb_delayed >= s->nb_fcs) {
-        if ((ret = wait_delayed_frame(s, output, got_output)) < 0)
-            return ret;
-    }
+
     return 0;
 }
 
+static int read_packet_job(VVCContext *s)
+{
+    const int ret = read_packet(s, s->async_pkt);
+
+    av_packet_unref(s->async_pkt);
+    return ret;
+}
+
+/*
+ * Only the bitstream reader runs in the job, on the executor, while the caller
+ * waits for a free frame context. Activating the parameter sets, deriving the
+ * slice headers and the frame setup touch avctx and the frame contexts in
+ * flight, they stay on this thread after the wait.
+ */
+static int decode_frame_async(VVCContext *s, AVFrame *output, int *got_output, AVPacket *avpkt)
+{
+    const int async = av_packet_ref(s->async_pkt, avpkt) >= 0;
+    int ret, err = 0;
+
+    if (async)
+        ff_vvc_job_submit(s, read_packet_job);
+
+    if (output_ready(s))
+        err = wait_delayed_frame(s, output, got_output);
+
+    // the packet is decoded even if the output failed
+    ret = async ? ff_vvc_job_wait(s) : read_packet(s, avpkt);
+    if (ret >= 0)
+        ret = decode_packet(s);
+    if (ret < 0)
+        return ret;
+    if (err < 0)
+        return err;
+
+    return avpkt->size;
+}
+
 static int get_decoded_frame(VVCContext *s, AVFrame *output, int *got_output)
 {
     int ret;
@@ -851,7 +1049,7 @@ static int get_decoded_frame(VVCContext *s, AVFrame *output, int *got_output)
     }
     if (s->nb_frames) {
         //we still have frames cached in dpb.
-        VVCFrameContext *last = get_frame_context(s, s->fcs, s->nb_frames - 1);
+        VVCFrameContext *last = frame_context_of(s, s->nb_frames - 1);
 
         ret = ff_vvc_output_frame(s, last, output, 0, 1);
         if (ret < 0)
@@ -869,24 +1067,24 @@ static int vvc_decode_frame(AVCodecContext *avctx, AVFrame *output,
     int *got_output, AVPacket *avpkt)
 {
     VVCContext *s = avctx->priv_data;
-    VVCFrameContext *fc;
     int ret;
 
     if (!avpkt->size)
         return get_decoded_frame(s, output, got_output);
 
-    fc = get_frame_context(s, s->fcs, s->nb_frames);
-
-    fc->nb_slices = 0;
-    fc->decode_order = s->nb_frames;
+    if (s->async_parse)
+        return decode_frame_async(s, output, got_output, avpkt);
 
-    ret = decode_nal_units(s, fc, avpkt);
+    ret = read_packet(s, avpkt);
+    if (ret >= 0)
+        ret = decode_packet(s);
     if (ret < 0)
         return ret;
 
-    ret = submit_frame(s, fc, output, got_output);
-    if (ret < 0)
-        return ret;
+    if (output_ready(s)) {
+        if ((ret = wait_delayed_frame(s, output, got_output)) < 0)
+            return ret;
+    }
 
     return avpkt->size;
 }
@@ -900,8 +1098,11 @@ static av_cold void vvc_decode_flush(AVCodecContext *avctx)
     while (s->nb_delayed)
         wait_delayed_frame(s, NULL, &got_output);
 
-    last = get_frame_context(s, s->fcs, s->nb_frames - 1);
-    ff_vvc_flush_dpb(last);
+    // init may have failed before the frame contexts were allocated
+    if (s->fcs) {
+        last = frame_context_of(s, s->nb_frames - 1);
+        ff_vvc_flush_dpb(last);
+    }
 
     s->eos = 1;
 }
@@ -912,9 +1113,11 @@ static av_cold int vvc_decode_free(AVCodecContext *avctx)
 
     ff_cbs_fragment_free(&s->current_frame);
     vvc_decode_flush(avctx);
-    ff_vvc_executor_free(&s->executor);
+    ff_vvc_executor_free(s);
+    av_packet_free(&s->async_pkt);
+    av_freep(&s->roi_subpic_ids);
     if (s->fcs) {
-        for (int i = 0; i < s->nb_fcs; i++)
+        for (int i = 0; i < s->max_fcs; i++)
             frame_context_free(s->fcs + i);
         av_free(s->fcs);
     }
@@ -929,7 +1132,53 @@ static av_cold void init_default_scale_m(void)
     memset(&ff_vvc_default_scale_m, 16, sizeof(ff_vvc_default_scale_m));
 }
 
+// units the decoder looks into, the others are only split out of the packet
+static const CodedBitstreamUnitType decompose_unit_types[] = {
+    VVC_TRAIL_NUT,
+    VVC_STSA_NUT,
+    VVC_RADL_NUT,
+    VVC_RASL_NUT,
+    VVC_IDR_W_RADL,
+    VVC_IDR_N_LP,
+    VVC_CRA_NUT,
+    VVC_GDR_NUT,
+    VVC_VPS_NUT,
+    VVC_SPS_NUT,
+    VVC_PPS_NUT,
+    VVC_PH_NUT,
+    VVC_PREFIX_APS_NUT,
+    VVC_SUFFIX_APS_NUT,
+};
+
 #define VVC_MAX_DELAYED_FRAMES 16
+static av_cold int parse_subpics(VVCContext *s)
+{
+    const char *p = s->subpics;
+    int nb_ids    = 1;
+
+    for (const char *c = p; *c; c++)
+        nb_ids += *c == ',';
+
+    s->roi_subpic_ids = av_malloc_array(nb_ids, sizeof(*s->roi_subpic_ids));
+    if (!s->roi_subpic_ids)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < nb_ids; i++) {
+        char *end;
+        const long id = strtol(p, &end, 0);
+
+        if (end == p || id < 0 || id > UINT16_MAX || (*end && *end != ',')) {
+            av_log(s->avctx, AV_LOG_ERROR, "Invalid subpicture list: %s\n", s->subpics);
+            return AVERROR(EINVAL);
+        }
+        s->roi_subpic_ids[i] = id;
+        p = end + !!*end;
+    }
+    s->nb_roi_subpic_ids = nb_ids;
+
+    return 0;
+}
+
 static av_cold int vvc_decode_init(AVCodecContext *avctx)
 {
     VVCContext *s                  = avctx->priv_data;
@@ -941,31 +1190,54 @@ static av_cold int vvc_decode_init(AVCodecContext *avctx)
 
     s->avctx = avctx;
 
+    if (s->async_parse) {
+        s->async_pkt = av_packet_alloc();
+        if (!s->async_pkt)
+            return AVERROR(ENOMEM);
+    }
+
+    if (s->subpics && *s->subpics) {
+        ret = parse_subpics(s);
+        if (ret < 0)
+            return ret;
+    }
+
     ret = ff_cbs_init(&s->cbc, AV_CODEC_ID_VVC, avctx);
     if (ret)
         return ret;
 
+    s->cbc->decompose_unit_types    = decompose_unit_types;
+    s->cbc->nb_decompose_unit_types = FF_ARRAY_ELEMS(decompose_unit_types);
+    // vvc_ps.c keeps the derived parameter sets while the raw ones are unchanged
+    ((CodedBitstreamH266Context *)s->cbc->priv_data)->reuse_ps = 1;
+
     if (avctx->extradata_size > 0 && avctx->extradata) {
         ret = ff_cbs_read_extradata_from_codec(s->cbc, &s->current_frame, avctx);
         if (ret < 0)
             return ret;
     }
 
-    s->nb_fcs = (avctx->flags & AV_CODEC_FLAG_LOW_DELAY) ? 1 : delayed;
-    s->fcs = av_calloc(s->nb_fcs, sizeof(*s->fcs));
+    // with sliding_output a full window only bounds the latency, keep it for low delay
+    s->max_fcs = (avctx->flags & AV_CODEC_FLAG_LOW_DELAY) && !s->sliding_output ? 1 : delayed;
+    // bounded window, start with one frame in flight and grow on demand
+    if (s->max_frame_contexts)
+        s->max_fcs = FFMIN(s->max_fcs, s->max_frame_contexts);
+    s->nb_fcs = s->max_frame_contexts ? 1 : s->max_fcs;
+    s->fcs = av_calloc(s->max_fcs, sizeof(*s->fcs));
     if (!s->fcs)
         return AVERROR(ENOMEM);
 
-    for (int i = 0; i < s->nb_fcs; i++) {
+    for (int i = 0; i < s->max_fcs; i++) {
         VVCFrameContext *fc = s->fcs + i;
         ret = frame_context_init(fc, avctx);
         if (ret < 0)
             return ret;
     }
 
-    s->executor = ff_vvc_executor_alloc(s, thread_count);
-    if (!s->executor)
-        return AVERROR(ENOMEM);
+    // a shared executor serves many streams, size it to the machine by default
+    ret = ff_vvc_executor_alloc(s, s->shared_executor && !avctx->thread_count ? cpu_count : thread_count);
+    if (ret < 0)
+        return ret;
 
     s->eos = 1;
     GDR_SET_RECOVERED(s);
@@ -974,17 +1246,56 @@ static av_cold int vvc_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+#define OFFSET(x) offsetof(VVCContext, x)
+#define PAR (AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)
+static const AVOption options[] = {
+    { "shared_executor", "Run tasks on an executor shared by all VVC decoders in the process", OFFSET(shared_executor),
+        AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "task_priority", "Priority of this decoder's tasks on the shared executor, only ordered against tasks queued on the same worker", OFFSET(task_priority),
+        AV_OPT_TYPE_INT, {.i64 = 0}, -100, 100, PAR },
+    { "task_stats", "Collect per-stage task statistics and log them when the decoder is closed", OFFSET(task_stats),
+        AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "pad_refs", "Extend the borders of the decoded frames so motion compensation reads them without edge emulation", OFFSET(pad_refs),
+        AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "task_granularity", "Amount of work handed to a worker per scheduled task", OFFSET(task_granularity),
+        AV_OPT_TYPE_INT, {.i64 = VVC_TASK_GRANULARITY_AUTO}, 0, VVC_TASK_GRANULARITY_ROW, PAR, .unit = "task_granularity" },
+        { "auto", "Pick from the CTU size and the picture size", 0,
+            AV_OPT_TYPE_CONST, {.i64 = VVC_TASK_GRANULARITY_AUTO}, 0, 0, PAR, .unit = "task_granularity" },
+        { "ctu",  "Schedule every stage of every CTU on its own", 0,
+            AV_OPT_TYPE_CONST, {.i64 = VVC_TASK_GRANULARITY_CTU},  0, 0, PAR, .unit = "task_granularity" },
+        { "row",  "Let a task walk along its CTU row", 0,
+            AV_OPT_TYPE_CONST, {.i64 = VVC_TASK_GRANULARITY_ROW},  0, 0, PAR, .unit = "task_granularity" },
+    { "sliding_output", "Output each frame as soon as it is decoded, keeping frame threads with the low_delay flag", OFFSET(sliding_output),
+        AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "async_parse", "Run the bitstream reader on a worker thread while waiting for a free frame context, the frame setup stays on the caller", OFFSET(async_parse),
+        AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "subpics", "Comma separated IDs of the subpictures to decode, all if unset", OFFSET(subpics),
+        AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, PAR },
+    { "max_frame_contexts", "Maximum number of frames in flight, grown to on demand, 0 for a fixed number", OFFSET(max_frame_contexts),
+        AV_OPT_TYPE_INT, {.i64 = 0}, 0, VVC_MAX_DELAYED_FRAMES, PAR },
+    { NULL },
+};
+
+static const AVClass vvc_decoder_class = {
+    .class_name = "VVC decoder",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const FFCodec ff_vvc_decoder = {
     .p.name         = "vvc",
     .p.long_name    = NULL_IF_CONFIG_SMALL("VVC (Versatile Video Coding)"),
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_VVC,
     .priv_data_size = sizeof(VVCContext),
+    .p.priv_class   = &vvc_decoder_class,
     .init           = vvc_decode_init,
     .close          = vvc_decode_free,
     FF_CODEC_DECODE_CB(vvc_decode_frame),
     .flush          = vvc_decode_flush,
-    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_OTHER_THREADS,
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_OTHER_THREADS |
+                      AV_CODEC_CAP_DRAW_HORIZ_BAND,
     .caps_internal  = FF_CODEC_CAP_EXPORTS_CROPPING | FF_CODEC_CAP_INIT_CLEANUP |
                       FF_CODEC_CAP_AUTO_THREADS,
     .p.profiles     = NULL_IF_CONFIG_SMALL(ff_vvc_profiles),
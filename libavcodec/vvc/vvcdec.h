@@ -42,6 +42,8 @@
 #define L0                      0
 #define L1                      1
 
+#define REF_PADDING             64                      ///< luma guard band of the frames with pad_refs
+
 typedef struct RefPicList {
     struct VVCFrame *ref[VVC_MAX_REF_ENTRIES];
     int list[VVC_MAX_REF_ENTRIES];
@@ -56,7 +58,7 @@ typedef struct RefPicListTab {
 typedef struct VVCFrame {
     struct AVFrame *frame;
 
-    struct MvField *tab_dmvr_mvf;               ///< RefStruct reference
+    struct ColMvField *tab_col_mvf;             ///< RefStruct reference
     RefPicListTab **rpl_tab;                    ///< RefStruct reference
     RefPicListTab  *rpl;                        ///< RefStruct reference
     int nb_rpl_elems;
@@ -113,11 +115,21 @@ typedef struct VVCFrameContext {
 
     uint64_t decode_order;
 
-    struct FFRefStructPool *tab_dmvr_mvf_pool;
+    int skip_frame;         ///< the frame is discarded, see AVCodecContext.skip_frame
+    int skip_loop_filter;   ///< the in-loop filters are not applied, see AVCodecContext.skip_loop_filter
+    int skip_idct;          ///< the residuals are not added, see AVCodecContext.skip_idct
+    int roi_only;           ///< only the slices of the subpictures listed in VVCContext.subpics are decoded
+
+    int ref_padding;        ///< luma guard band around the frames in the DPB, 0 if none
+
+    struct FFRefStructPool *tab_col_mvf_pool;
     struct FFRefStructPool *rpl_tab_pool;
+    struct FFRefStructPool *rpl_pool;
+    struct FFRefStructPool *progress_pool;
 
     struct FFRefStructPool *cu_pool;
     struct FFRefStructPool *tu_pool;
+    struct FFRefStructPool *coeff_pool;
 
     struct {
         int16_t *slice_idx;
@@ -167,7 +179,6 @@ typedef struct VVCFrameContext {
         uint8_t *alf_pixel_buffer_h[VVC_MAX_SAMPLE_ARRAYS][2];
         uint8_t *alf_pixel_buffer_v[VVC_MAX_SAMPLE_ARRAYS][2];
 
-        int         *coeffs;
         struct CTU  *ctus;
 
         //used in arrays_init only
@@ -183,11 +194,19 @@ typedef struct VVCFrameContext {
             int height;
             int chroma_format_idc;
             int pixel_shift;
+            int nb_rpl_elems;
         } sz;
     } tab;
 } VVCFrameContext;
 
+enum VVCTaskGranularity {
+    VVC_TASK_GRANULARITY_AUTO,
+    VVC_TASK_GRANULARITY_CTU,          ///< every ready task goes through the scheduler
+    VVC_TASK_GRANULARITY_ROW,          ///< a task runs its right neighbour inline when it gets ready
+};
+
 typedef struct VVCContext {
+    const struct AVClass *c;    ///< needs to be first for AVOptions
     struct AVCodecContext *avctx;
 
     CodedBitstreamContext *cbc;
@@ -213,9 +232,27 @@ typedef struct VVCContext {
     uint16_t seq_output;
 
     struct AVExecutor *executor;
+    struct VVCScheduler *scheduler;
+    int shared_executor;    ///< AVOption, use the process-wide executor
+    int task_priority;      ///< AVOption, priority of our tasks in a shared executor
+    int task_stats;         ///< AVOption, collect per-stage task statistics and log them on close
+    int pad_refs;           ///< AVOption, allocate the frames with a guard band and extend their borders
+    int task_granularity;   ///< AVOption, enum VVCTaskGranularity
+    int sliding_output;     ///< AVOption, output the oldest frame as soon as it is done
+    int async_parse;        ///< AVOption, read the packets on a worker
+    char *subpics;          ///< AVOption, comma separated IDs of the subpictures to decode
+    int max_frame_contexts; ///< AVOption, bound of nb_fcs which then grows on demand, 0 for a fixed window
+
+    int *roi_subpic_ids;    ///< parsed from subpics
+    int nb_roi_subpic_ids;
+    int roi_fallback;       ///< subpics is set but the last frame was decoded in full
+
+    struct AVPacket *async_pkt; ///< packet being read by the async job
 
     VVCFrameContext *fcs;
-    int nb_fcs;
+    int nb_fcs;             ///< frame contexts in use, the window of frames in flight
+    int max_fcs;            ///< allocated frame contexts
+    uint64_t fc_base;       ///< frame n in decode order uses fcs[(n - fc_base) % nb_fcs]
 
     uint64_t nb_frames;     ///< processed frames
     int nb_delayed;         ///< delayed frames
@@ -20,11 +20,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
 #include "cbs.h"
 #include "cbs_h266.h"
 #include "parser.h"
 
 #define START_CODE 0x000001 ///< start_code_prefix_one_3bytes
+#define SLICE_PREFIX_SIZE 1024 ///< bytes of a slice NAL unit handed to CBS, enough for its header
 #define IS_IDR(nut)   (nut == VVC_IDR_W_RADL || nut == VVC_IDR_N_LP)
 #define IS_H266_SLICE(nut) (nut <= VVC_RASL_NUT || (nut >= VVC_IDR_W_RADL && nut <= VVC_GDR_NUT))
 
@@ -53,6 +57,9 @@ typedef struct VVCParserContext {
 
     AuDetector au_detector;
 
+    uint8_t *headers;               ///< the NAL units the parser looks at, slices truncated
+    unsigned int headers_allocated;
+
     int parsed_extradata;
 } VVCParserContext;
 
@@ -322,6 +329,110 @@ static int get_pu_info(PuInfo *info, const CodedBitstreamH266Context *h266,
     return ret;
 }
 
+static const uint8_t *find_nal_start(const uint8_t *p, const uint8_t *end)
+{
+    while (p + 2 < end) {
+        if (p[2] > 1)
+            p += 3;
+        else if (p[1])
+            p += 2;
+        else if (p[0] || p[2] != 1)
+            p++;
+        else
+            return p + 3;
+    }
+    return end;
+}
+
+/**
+ * Append the NAL unit to ctx->headers if the parser needs it, keeping only
+ * the first SLICE_PREFIX_SIZE bytes of slices.
+ *
+ * @return < 0 for error, 1 if the NAL unit was truncated, 0 otherwise.
+ */
+static int copy_nal(VVCParserContext *ctx, int *len, const uint8_t *nal,
+                    int size, int nal_length_size)
+{
+    const int nut = size >= 2 ? nal[1] >> 3 : -1;
+    int truncated = 0;
+    uint8_t *p;
+
+    if (IS_H266_SLICE(nut)) {
+        truncated = size > SLICE_PREFIX_SIZE;
+        size      = FFMIN(size, SLICE_PREFIX_SIZE);
+    } else if (nut != VVC_VPS_NUT && nut != VVC_SPS_NUT &&
+               nut != VVC_PPS_NUT && nut != VVC_PH_NUT) {
+        return 0;
+    }
+
+    p = av_fast_realloc(ctx->headers, &ctx->headers_allocated,
+                        *len + 4 + size);
+    if (!p)
+        return AVERROR(ENOMEM);
+    ctx->headers = p;
+    p += *len;
+
+    if (nal_length_size) {
+        for (int i = nal_length_size - 1; i >= 0; i--)
+            *p++ = size >> (8 * i);
+    } else {
+        AV_WB24(p, START_CODE);
+        p += 3;
+    }
+    memcpy(p, nal, size);
+    *len = p + size - ctx->headers;
+
+    return truncated;
+}
+
+/**
+ * Gather the parameter sets, picture headers and slice header prefixes of
+ * the picture unit, so that CBS neither copies nor unescapes slice data.
+ *
+ * @return < 0 for error, the size of ctx->headers otherwise. *truncated is
+ *         set if any slice was cut short.
+ */
+static int copy_headers(VVCParserContext *ctx, const uint8_t *buf,
+                        int buf_size, int *truncated)
+{
+    const CodedBitstreamH2645Context *h2645 = ctx->cbc->priv_data;
+    const uint8_t *end = buf + buf_size;
+    int len = 0, ret;
+
+    *truncated = 0;
+    if (h2645->mp4) {
+        const int nal_length_size = h2645->nal_length_size;
+
+        while (end - buf >= nal_length_size) {
+            int64_t size = 0;
+
+            for (int i = 0; i < nal_length_size; i++)
+                size = (size << 8) | *buf++;
+            if (size > end - buf)
+                return AVERROR_INVALIDDATA;
+            ret = copy_nal(ctx, &len, buf, size, nal_length_size);
+            if (ret < 0)
+                return ret;
+            *truncated |= ret;
+            buf += size;
+        }
+    } else {
+        const uint8_t *nal = find_nal_start(buf, end);
+
+        while (nal < end) {
+            const uint8_t *next = find_nal_start(nal, end);
+            const int size = (next < end ? next - 3 : end) - nal;
+
+            ret = copy_nal(ctx, &len, nal, size, 0);
+            if (ret < 0)
+                return ret;
+            *truncated |= ret;
+            nal = next;
+        }
+    }
+    return len;
+}
+
 static int append_au(AVPacket *pkt, const uint8_t *buf, int buf_size)
 {
     int offset = pkt->size;
@@ -349,7 +460,7 @@ static int parse_nal_units(AVCodecParserContext *s, const uint8_t *buf,
     const CodedBitstreamH266Context *h266 = ctx->cbc->priv_data;
 
     CodedBitstreamFragment *pu = &ctx->picture_unit;
-    int ret;
+    int ret, truncated;
     PuInfo info;
 
     if (!buf_size) {
@@ -360,7 +471,15 @@ static int parse_nal_units(AVCodecParserContext *s, const uint8_t *buf,
         return 1;
     }
 
-    if ((ret = ff_cbs_read(ctx->cbc, pu, buf, buf_size)) < 0) {
+    if ((ret = copy_headers(ctx, buf, buf_size, &truncated)) < 0)
+        goto end;
+    ret = ff_cbs_read(ctx->cbc, pu, ctx->headers, ret);
+    if (ret < 0 && truncated) {
+        // a slice header did not fit in the prefix, read the whole unit
+        ff_cbs_fragment_reset(pu);
+        ret = ff_cbs_read(ctx->cbc, pu, buf, buf_size);
+    }
+    if (ret < 0) {
         av_log(avctx, AV_LOG_ERROR, "Failed to parse picture unit.\n");
         goto end;
     }
@@ -477,7 +596,6 @@ static const CodedBitstreamUnitType decompose_unit_types[] = {
     VVC_SPS_NUT,
     VVC_PPS_NUT,
     VVC_PH_NUT,
-    VVC_AUD_NUT,
 };
 
 static av_cold int vvc_parser_init(AVCodecParserContext *s)
@@ -492,6 +610,7 @@ static av_cold int vvc_parser_init(AVCodecParserContext *s)
 
     ctx->cbc->decompose_unit_types    = decompose_unit_types;
     ctx->cbc->nb_decompose_unit_types = FF_ARRAY_ELEMS(decompose_unit_types);
+    ((CodedBitstreamH266Context *)ctx->cbc->priv_data)->reuse_ps = 1;
 
     return ret;
 }
@@ -503,6 +622,7 @@ static av_cold void vvc_parser_close(AVCodecParserContext *s)
     av_packet_unref(&ctx->au);
     av_packet_unref(&ctx->last_au);
     ff_cbs_fragment_free(&ctx->picture_unit);
+    av_freep(&ctx->headers);
 
     ff_cbs_close(&ctx->cbc);
     av_freep(&ctx->pc.buffer);
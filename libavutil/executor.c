@@ -17,6 +17,8 @@
  * License along with FFmpeg; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+#include <stdatomic.h>
+
 #include "internal.h"
 #include "mem.h"
 #include "thread.h"
@@ -39,6 +41,17 @@
 
 #endif //!HAVE_THREADS
 
+/*
+ * Every worker owns a task queue. New tasks are spread over the queues,
+ * a worker serves its own queue first and steals from the others when it
+ * runs dry, so the only lock taken on the hot path is a short per-queue one.
+ */
+typedef struct TaskQueue {
+    AVMutex lock;
+    AVTask *tasks;                  ///< sorted by priority_higher, protected by lock
+    atomic_int nb_tasks;            ///< lets other workers skip an empty queue without locking it
+} TaskQueue;
+
 typedef struct ThreadInfo {
     AVExecutor *e;
     ExecutorThread thread;
@@ -51,11 +64,16 @@ struct AVExecutor {
     ThreadInfo *threads;
     uint8_t *local_contexts;
 
+    TaskQueue *queues;
+    int nb_queues;
+    atomic_uint next_queue;
+
+    // lock and cond are only used to park idle workers
     AVMutex lock;
     AVCond cond;
-    int die;
-
-    AVTask *tasks;
+    atomic_int die;
+    atomic_int nb_sleeping;
+    atomic_uint generation;         ///< bumped by every av_executor_execute()
 };
 
 static AVTask* remove_task(AVTask **prev, AVTask *t)
@@ -71,19 +89,52 @@ static void add_task(AVTask **prev, AVTask *t)
     *prev   = t;
 }
 
-static int run_one_task(AVExecutor *e, void *lc)
+static AVTask* queue_get_ready_task(TaskQueue *q, const AVTaskCallbacks *cb)
 {
-    AVTaskCallbacks *cb = &e->cb;
     AVTask **prev;
+    AVTask *t = NULL;
 
-    for (prev = &e->tasks; *prev && !cb->ready(*prev, cb->user_data); prev = &(*prev)->next)
+    ff_mutex_lock(&q->lock);
+    for (prev = &q->tasks; *prev && !cb->ready(*prev, cb->user_data); prev = &(*prev)->next)
         /* nothing */;
     if (*prev) {
-        AVTask *t = remove_task(prev, *prev);
-        ff_mutex_unlock(&e->lock);
-        cb->run(t, lc, cb->user_data);
-        ff_mutex_lock(&e->lock);
-        return 1;
+        t = remove_task(prev, *prev);
+        atomic_fetch_sub(&q->nb_tasks, 1);
+    }
+    ff_mutex_unlock(&q->lock);
+
+    return t;
+}
+
+static void queue_add_task(TaskQueue *q, const AVTaskCallbacks *cb, AVTask *t)
+{
+    AVTask **prev;
+
+    ff_mutex_lock(&q->lock);
+    for (prev = &q->tasks; *prev && cb->priority_higher(*prev, t); prev = &(*prev)->next)
+        /* nothing */;
+    add_task(prev, t);
+    atomic_fetch_add(&q->nb_tasks, 1);
+    ff_mutex_unlock(&q->lock);
+}
+
+// try the worker's own queue first, then steal from the others
+static int run_one_task(AVExecutor *e, const int idx, void *lc)
+{
+    AVTaskCallbacks *cb = &e->cb;
+
+    for (int i = 0; i < e->nb_queues; i++) {
+        TaskQueue *q = e->queues + (idx + i) % e->nb_queues;
+        AVTask *t;
+
+        if (!atomic_load(&q->nb_tasks))
+            continue;
+
+        t = queue_get_ready_task(q, cb);
+        if (t) {
+            cb->run(t, lc, cb->user_data);
+            return 1;
+        }
     }
     return 0;
 }
@@ -93,18 +144,23 @@ static void *executor_worker_task(void *data)
 {
     ThreadInfo *ti = (ThreadInfo*)data;
     AVExecutor *e  = ti->e;
-    void *lc       = e->local_contexts + (ti - e->threads) * e->cb.local_context_size;
+    const int idx  = ti - e->threads;
+    void *lc       = e->local_contexts + idx * e->cb.local_context_size;
 
-    ff_mutex_lock(&e->lock);
-    while (1) {
-        if (e->die) break;
+    while (!atomic_load(&e->die)) {
+        const unsigned generation = atomic_load(&e->generation);
 
-        if (!run_one_task(e, lc)) {
-            //no task in one loop
+        if (run_one_task(e, idx, lc))
+            continue;
+
+        //no ready task in any queue, sleep until somebody adds one
+        ff_mutex_lock(&e->lock);
+        atomic_fetch_add(&e->nb_sleeping, 1);
+        while (!atomic_load(&e->die) && atomic_load(&e->generation) == generation)
             ff_cond_wait(&e->cond, &e->lock);
-        }
+        atomic_fetch_sub(&e->nb_sleeping, 1);
+        ff_mutex_unlock(&e->lock);
     }
-    ff_mutex_unlock(&e->lock);
     return NULL;
 }
 #endif
@@ -114,7 +170,7 @@ static void executor_free(AVExecutor *e, const int has_lock, const int has_cond)
     if (e->thread_count) {
         //signal die
         ff_mutex_lock(&e->lock);
-        e->die = 1;
+        atomic_store(&e->die, 1);
         ff_cond_broadcast(&e->cond);
         ff_mutex_unlock(&e->lock);
 
@@ -126,6 +182,10 @@ static void executor_free(AVExecutor *e, const int has_lock, const int has_cond)
     if (has_lock)
         ff_mutex_destroy(&e->lock);
 
+    for (int i = 0; i < e->nb_queues; i++)
+        ff_mutex_destroy(&e->queues[i].lock);
+
+    av_free(e->queues);
     av_free(e->threads);
     av_free(e->local_contexts);
 
@@ -136,6 +196,7 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
 {
     AVExecutor *e;
     int has_lock = 0, has_cond = 0;
+    const int nb_queues = FFMAX(thread_count, 1);
     if (!cb || !cb->user_data || !cb->ready || !cb->run || !cb->priority_higher)
         return NULL;
 
@@ -143,8 +204,12 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
     if (!e)
         return NULL;
     e->cb = *cb;
+    atomic_init(&e->die, 0);
+    atomic_init(&e->nb_sleeping, 0);
+    atomic_init(&e->generation, 0);
+    atomic_init(&e->next_queue, 0);
 
-    e->local_contexts = av_calloc(thread_count, e->cb.local_context_size);
+    e->local_contexts = av_calloc(nb_queues, e->cb.local_context_size);
     if (!e->local_contexts)
         goto free_executor;
 
@@ -152,6 +217,17 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
     if (!e->threads)
         goto free_executor;
 
+    e->queues = av_calloc(nb_queues, sizeof(*e->queues));
+    if (!e->queues)
+        goto free_executor;
+
+    for (/* nothing */; e->nb_queues < nb_queues; e->nb_queues++) {
+        TaskQueue *q = e->queues + e->nb_queues;
+        if (ff_mutex_init(&q->lock, NULL))
+            goto free_executor;
+        atomic_init(&q->nb_tasks, 0);
+    }
+
     has_lock = !ff_mutex_init(&e->lock, NULL);
     has_cond = !ff_cond_init(&e->cond, NULL);
 
@@ -182,20 +258,24 @@ void av_executor_free(AVExecutor **executor)
 void av_executor_execute(AVExecutor *e, AVTask *t)
 {
     AVTaskCallbacks *cb = &e->cb;
-    AVTask **prev;
 
-    ff_mutex_lock(&e->lock);
     if (t) {
-        for (prev = &e->tasks; *prev && cb->priority_higher(*prev, t); prev = &(*prev)->next)
-            /* nothing */;
-        add_task(prev, t);
+        const unsigned idx = atomic_fetch_add(&e->next_queue, 1) % e->nb_queues;
+        queue_add_task(e->queues + idx, cb, t);
+    }
+
+    // pairs with the nb_sleeping/generation check in executor_worker_task,
+    // the lock is only touched when a worker is parked
+    atomic_fetch_add(&e->generation, 1);
+    if (atomic_load(&e->nb_sleeping)) {
+        ff_mutex_lock(&e->lock);
+        ff_cond_signal(&e->cond);
+        ff_mutex_unlock(&e->lock);
     }
-    ff_cond_signal(&e->cond);
-    ff_mutex_unlock(&e->lock);
 
 #if !HAVE_THREADS
     // We are running in a single-threaded environment, so we must handle all tasks ourselves
-    while (run_one_task(e, e->local_contexts))
+    while (run_one_task(e, 0, e->local_contexts))
         /* nothing */;
 #endif
 }
@@ -0,0 +1,154 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Runs a wavefront of dependent tasks, the same shape as a WPP decode:
+ * a task is ready once its left and top-right neighbours are done.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "libavutil/executor.h"
+#include "libavutil/macros.h"
+#include "libavutil/thread.h"
+
+#define WIDTH  24
+#define HEIGHT 16
+
+typedef struct Task {
+    AVTask task;
+    int x, y;
+} Task;
+
+typedef struct Grid {
+    Task tasks[HEIGHT][WIDTH];
+    atomic_int done[HEIGHT][WIDTH];
+    atomic_int nb_done;
+    atomic_int errors;
+
+    AVMutex lock;
+    AVCond cond;
+} Grid;
+
+static int is_done(Grid *g, const int x, const int y)
+{
+    if (x < 0 || y < 0 || x >= WIDTH)
+        return 1;
+    return atomic_load(&g->done[y][x]);
+}
+
+static int task_priority_higher(const AVTask *_a, const AVTask *_b)
+{
+    const Task *a = (const Task *)_a;
+    const Task *b = (const Task *)_b;
+
+    if (a->x + a->y != b->x + b->y)
+        return a->x + a->y < b->x + b->y;
+    return a->y < b->y;
+}
+
+static int task_ready(const AVTask *_t, void *user_data)
+{
+    const Task *t = (const Task *)_t;
+    Grid *g       = user_data;
+
+    return is_done(g, t->x - 1, t->y) && is_done(g, t->x + 1, t->y - 1);
+}
+
+static int task_run(AVTask *_t, void *local_context, void *user_data)
+{
+    const Task *t = (const Task *)_t;
+    Grid *g       = user_data;
+    int *nb_run   = local_context;
+
+    if (!task_ready(_t, user_data) || atomic_load(&g->done[t->y][t->x]))
+        atomic_fetch_add(&g->errors, 1);
+    (*nb_run)++;
+
+    atomic_store(&g->done[t->y][t->x], 1);
+    if (atomic_fetch_add(&g->nb_done, 1) + 1 == WIDTH * HEIGHT) {
+        ff_mutex_lock(&g->lock);
+        ff_cond_signal(&g->cond);
+        ff_mutex_unlock(&g->lock);
+    }
+    return 0;
+}
+
+static int run_grid(Grid *g, const int thread_count)
+{
+    AVTaskCallbacks cb = {
+        g,
+        sizeof(int),
+        task_priority_higher,
+        task_ready,
+        task_run,
+    };
+    AVExecutor *e;
+
+    atomic_store(&g->nb_done, 0);
+    atomic_store(&g->errors, 0);
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            Task *t = &g->tasks[y][x];
+            t->x = x;
+            t->y = y;
+            atomic_store(&g->done[y][x], 0);
+        }
+    }
+
+    e = av_executor_alloc(&cb, thread_count);
+    if (!e)
+        return -1;
+
+    // submit in reverse order so most tasks are not ready when queued
+    for (int y = HEIGHT - 1; y >= 0; y--)
+        for (int x = WIDTH - 1; x >= 0; x--)
+            av_executor_execute(e, &g->tasks[y][x].task);
+
+    ff_mutex_lock(&g->lock);
+    while (atomic_load(&g->nb_done) != WIDTH * HEIGHT)
+        ff_cond_wait(&g->cond, &g->lock);
+    ff_mutex_unlock(&g->lock);
+
+    av_executor_free(&e);
+
+    return atomic_load(&g->errors);
+}
+
+int main(void)
+{
+    static const int thread_counts[] = { 1, 2, 3, 8, 17 };
+    static Grid g;
+    int ret = 0;
+
+    if (ff_mutex_init(&g.lock, NULL) || ff_cond_init(&g.cond, NULL))
+        return 1;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(thread_counts); i++) {
+        const int errors = run_grid(&g, thread_counts[i]);
+        printf("%2d threads: %s\n", thread_counts[i], errors ? "FAIL" : "OK");
+        if (errors)
+            ret = 1;
+    }
+
+    ff_cond_destroy(&g.cond);
+    ff_mutex_destroy(&g.lock);
+
+    return ret;
+}